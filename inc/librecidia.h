@@ -0,0 +1,73 @@
+#ifndef LIBRECIDIA_H
+#define LIBRECIDIA_H
+
+#include <stddef.h>
+
+/*
+ * The spectrum pipeline without any globals or threads of its own.
+ * Push audio samples in, pull spectrum frames out into caller owned buffers.
+ * A pipeline must only be used by one thread at a time, separate pipelines are independent.
+ * Tables derived from a config can be prepared on another thread and installed between frames.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Layout of the plots using 2 bézier curves, frequencies above Nyquist are clamped
+struct recidia_chart_guide {
+    float start_freq;
+    float start_ctrl; // Control point of the first bézier curve
+    float mid_freq;
+    float mid_pos; // Position of "mid_freq" [0.0]-[1.0]
+    float end_ctrl; // Control point of the second bézier curve
+    float end_freq;
+};
+
+struct recidia_pipeline_config {
+    unsigned int sample_rate;
+    unsigned int buffer_size; // Samples per FFT
+    unsigned int plots_count; // Plots per frame
+    unsigned int interp; // Frames averaged together, 0 is off
+    float savgol_window_size; // Relative to "plots_count" [0.0]-[1.0], 0.0 is off
+    unsigned int savgol_poly_order;
+    struct recidia_chart_guide chart_guide;
+    int measure_fft; // Time FFT algorithms when planning, else frames are reproducible run to run
+};
+
+typedef struct recidia_pipeline recidia_pipeline;
+// FFT plan, chart table and Savitzky Golay coefficients of a config
+typedef struct recidia_pipeline_tables recidia_pipeline_tables;
+
+// NULL if the config is invalid
+recidia_pipeline *recidia_pipeline_create(const struct recidia_pipeline_config *config);
+// Only redoes what changed, returns -1 and keeps the old config if invalid
+int recidia_pipeline_configure(recidia_pipeline *pipeline, const struct recidia_pipeline_config *config);
+// Effective config, after clamping
+void recidia_pipeline_get_config(const recidia_pipeline *pipeline, struct recidia_pipeline_config *config);
+// Clears samples and interpolation, the next pulled frame is "frame_index"
+// Frames are the same bit for bit when pulled at the same index
+void recidia_pipeline_reset(recidia_pipeline *pipeline, unsigned long long frame_index);
+void recidia_pipeline_destroy(recidia_pipeline *pipeline);
+
+// NULL if the config is invalid, doesn't touch any pipeline so it can run while one keeps pulling
+// Only the tables that differ from "base" are built, NULL builds them all
+// "base" is the config of the pipeline they will be installed in, from recidia_pipeline_get_config()
+recidia_pipeline_tables *recidia_pipeline_prepare(const struct recidia_pipeline_config *config,
+                                                  const struct recidia_pipeline_config *base);
+// Swaps in the tables and takes them, cheap enough between frames
+// Returns -1 and keeps the old config if the pipeline's config is no longer their "base"
+int recidia_pipeline_install(recidia_pipeline *pipeline, recidia_pipeline_tables *tables);
+// Tables that won't be installed
+void recidia_pipeline_tables_destroy(recidia_pipeline_tables *tables);
+
+// Only the latest "buffer_size" samples are kept, silence before the first push
+void recidia_pipeline_push(recidia_pipeline *pipeline, const short *samples, size_t count);
+// Writes a frame of the latest samples to "plots", returns the plots written
+unsigned int recidia_pipeline_pull(recidia_pipeline *pipeline, float *plots);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,21 @@
+#include <sys/types.h>
+#include <vector>
+
+#include <librecidia.h>
+
+#pragma once
+
+// Processing stages behind the pipeline in librecidia.h
+void create_chart_table(uint chart_size, uint *chart_table, uint sample_rate, uint buffer_size,
+                        const struct recidia_chart_guide &chart_guide);
+std::vector<float> get_savgol_coeffs(int window_size, int poly_order);
+// Real window size from the relative one, 0 if the filter is off
+uint get_savgol_window_size(float relative_size, uint plots_count, uint poly_order);
+
+void normalize_fft_output(double *fft_out, uint buffer_size);
+void apply_chart_table(const double *fft_out, const uint *chart_table, uint plots_count, float *plots);
+// scratch is reused between calls to avoid allocating every frame
+void apply_savgol_filter(float *plots, uint plots_count, const std::vector<float> &coeffs, std::vector<float> &scratch);
+// interp_history holds "interp" rows of "history_stride" plots
+void apply_interpolation(float *plots, uint plots_count, float *interp_history, uint history_stride,
+                         uint interp, uint &interp_index);
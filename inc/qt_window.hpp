@@ -8,8 +8,16 @@
 #include <QLabel>
 #include <QTimer>
 
+#include <QSocketNotifier>
+
 #include <string>
 #include <vector>
+#include <thread>
+#include <atomic>
+#include <sys/types.h>
+
+#include <recidia.h>
+#include <render.hpp>
 
 #pragma once
 
@@ -40,7 +48,8 @@ class SettingsTabWidget : public QTabWidget {
         QSlider *plotWidthSlider;
         QSlider *gapWidthSlider;
         QPushButton *drawModeButton;
-        // QSpinBox *fpsCapSpinBox;
+        QPushButton *layoutButton;
+        QSpinBox *fpsCapSpinBox;
         // Prevent multiple dialogs
         bool main_color_dialog_up = false;
         bool back_color_dialog_up = false;
@@ -61,7 +70,7 @@ class VerticalLabel : public QLabel {
 class VulkanWindow : public QVulkanWindow {
     
     public:
-        int shader_setting_change;
+        int shader_setting_change = 0; // Bits, 1 is the main shader, 2 is the back shader, 4 is the spectrogram's
 
         QVulkanWindowRenderer *createRenderer() override;
         MainWindow *main_window;
@@ -80,18 +89,75 @@ class VulkanRenderer : public QVulkanWindowRenderer {
         void releaseSwapChainResources() override;
         void releaseResources() override;
         void startNextFrame() override;
-        void recreatePipline();
 
     private:
         double last_frame_time;
+        u_int64_t next_frame_time = 0; // Deadline of the next frame
+        QTimer *frame_timer = nullptr;
+        void scheduleNextFrame(u_int64_t now);
+
+        // Render on demand, what the last frame was drawn from
+        bool isFrameDue();
+        recidia_plots_history plots_history = {};
+        unsigned int drawn_width = 0, drawn_height = 0;
+        std::vector<char> drawn_settings;
+        bool main_animated = true, back_animated = true; // Shaders using "time"
         
-        VkDeviceMemory m_bufMem = VK_NULL_HANDLE;
-        VkBuffer m_buf = VK_NULL_HANDLE;
-        VkDescriptorBufferInfo m_uniformBufInfo[QVulkanWindow::MAX_CONCURRENT_FRAME_COUNT];
-
-        VkDescriptorPool m_descPool = VK_NULL_HANDLE;
-        VkDescriptorSetLayout m_descSetLayout = VK_NULL_HANDLE;
-        VkDescriptorSet m_descSet[QVulkanWindow::MAX_CONCURRENT_FRAME_COUNT];
+        // Plots, audio uniforms and their descriptor sets per frame
+        FrameResources m_frames;
+        // Rows of the "Spectrogram" draw mode
+        SpectrogramResources m_spectrogram;
+
+        // GPU time of the passes
+        void createQueryPool();
+        void readGpuTimes(int frame);
+        VkQueryPool m_queryPool = VK_NULL_HANDLE;
+        bool m_queriesWritten[QVulkanWindow::MAX_CONCURRENT_FRAME_COUNT] = {};
+        float m_timestampPeriod = 0.0;
+        u_int64_t m_timestampMask = 0;
+
+        // Derived from settings, only refreshed when they change
+        struct RenderState {
+            bool cached = false;
+            uint colors_generation;
+            float main_color[4]; // Linear, alpha premultiplied
+            float back_color[4];
+        } render_state;
+        void updateRenderState();
+
+        // Shader hot reload, pipelines are built on a worker and swapped in between frames
+        void watchShaders();
+        void readShaderEvents();
+        void startPipelinesBuild(int shaders);
+        void finishPipelinesBuild();
+        void retirePipeline(VkPipeline pipeline, VkPipelineLayout layout);
+        void destroyRetiredPipelines(bool all);
+
+        int inotify_fd = -1;
+        QSocketNotifier *shader_notifier = nullptr;
+
+        struct PipelinesBuild {
+            int shaders; // Same bits as "shader_setting_change"
+            std::string main_vertex, main_frag, back_vertex, back_frag;
+            VkPipelineLayout main_pipelineLayout = VK_NULL_HANDLE;
+            VkPipeline main_pipeline = VK_NULL_HANDLE;
+            VkPipelineLayout back_pipelineLayout = VK_NULL_HANDLE;
+            VkPipeline back_pipeline = VK_NULL_HANDLE;
+            VkPipelineLayout spectrogram_pipelineLayout = VK_NULL_HANDLE;
+            VkPipeline spectrogram_pipeline = VK_NULL_HANDLE;
+        } pipelines_build;
+        std::thread pipelines_worker;
+        std::atomic<bool> pipelines_built{false};
+        int pending_shaders = 0; // Changes while a build is running
+
+        // Destroyed once the frames that used them are done
+        struct RetiredPipeline {
+            VkPipeline pipeline;
+            VkPipelineLayout layout;
+            u_int64_t last_frame;
+        };
+        std::vector<RetiredPipeline> retired_pipelines;
+        u_int64_t frame_count = 0;
 
         VkPipelineLayout main_pipelineLayout = VK_NULL_HANDLE;
         VkPipeline main_pipeline = VK_NULL_HANDLE;
@@ -99,6 +165,9 @@ class VulkanRenderer : public QVulkanWindowRenderer {
         VkPipelineLayout back_pipelineLayout = VK_NULL_HANDLE;
         VkPipeline back_pipeline = VK_NULL_HANDLE;
 
+        VkPipelineLayout spectrogram_pipelineLayout = VK_NULL_HANDLE;
+        VkPipeline spectrogram_pipeline = VK_NULL_HANDLE;
+
         QMatrix4x4 m_proj;
         float m_rotation = 0.0f;
 };
@@ -117,6 +186,7 @@ class StatsWidget : public QWidget {
         QLabel *plotsCountLabel;
         QLabel *latencyLabel;
         QLabel *fpsLabel;
+        QLabel *gpuTimeLabel;
 
     protected:
         void hideEvent(QHideEvent *event) override;
@@ -1,6 +1,8 @@
 #ifndef RECIDIA_H 
 #define RECIDIA_H
 
+#include <librecidia.h>
+
 // Settings changes with keyboard
 enum setting_changes {
     SETTINGS_MENU_TOGGLE = 1, // Start at 1
@@ -34,6 +36,10 @@ enum setting_changes {
     STATS_TOGGLE,
 
     DRAW_MODE_TOGGLE,
+
+    LAYOUT_TOGGLE,
+
+    PLOT_GLYPHS_TOGGLE,
 };
 
 
@@ -63,6 +69,28 @@ struct port_device_info {
     struct port_device_info *next;
 };
 
+// Offline analysis output, frames follow the header as float[frames_count][plots_count]
+#define RECIDIA_SPECTRUM_MAGIC "RECIDIA"
+#define RECIDIA_SPECTRUM_VERSION 1
+
+struct recidia_spectrum_header {
+    char magic[8];
+    unsigned int version;
+    unsigned int header_size; // Offset of the first frame
+    unsigned int sample_rate;
+    unsigned int hop_size; // Samples between frames
+    unsigned int buffer_size;
+    unsigned int plots_count;
+    u_int64_t frames_count;
+    // Scale, plots / height_cap = relative height
+    float height_cap;
+    unsigned int interp;
+    float savgol_window_size;
+    float chart_guide[6]; // start_freq, start_ctrl, mid_freq, mid_pos, end_ctrl, end_freq
+    unsigned int savgol_poly_order; // 0 in files from before it was stored
+    unsigned char reserved[48]; // Pad to 128 bytes
+};
+
 typedef struct recidia_audio_data {
     unsigned int frame_index;
     unsigned int *buffer_size;
@@ -75,6 +103,8 @@ typedef struct recidia_audio_data {
 
 // C code
 #ifdef __cplusplus
+#include <vector>
+
 extern "C" {
     struct pipe_device_info *get_pipe_devices_info();
     struct pulse_device_info *get_pulse_devices_info();
@@ -122,14 +152,7 @@ struct recidia_data_settings {
         unsigned int poly_order; 
     } savgol_filter;
     
-    struct chart_guide {
-        float start_freq;
-        float start_ctrl;
-        float mid_freq;
-        float mid_pos;
-        float end_ctrl;
-        float end_freq;
-    } chart_guide;
+    struct recidia_chart_guide chart_guide;
     
     unsigned int poll_rate;
     recidia_const_setting<unsigned int> POLL_RATE;
@@ -148,12 +171,20 @@ struct recidia_design_settings {
     unsigned int gap_width;
     recidia_const_setting<unsigned int> GAP_WIDTH;
     int draw_mode;
+    unsigned int curve_subdivisions; // Quads between each pair of plots in the "Curve" draw mode
+    int layout; // "Linear"=0, "Mirrored"=1 and "Radial"=2
+    float inner_radius; // Radial, relative to the draw height [0.0]-[1.0]
+    float start_angle; // Radial, degrees clockwise from the top
     char **draw_chars;
+    int plot_glyphs; // Terminal, "Blocks"=0 are "draw_chars", "Braille"=1 and "Quadrants"=2
+    int gradient_mode; // Terminal, "Off"=0, "Height"=1 and "Frequency"=2
+    rgba_color gradient_colors[2]; // From the bottom or low frequencies
     unsigned int fps_cap;
     recidia_const_setting<unsigned int> FPS_CAP;
     
     rgba_color main_color;
     rgba_color back_color;
+    unsigned int colors_generation; // Bumped when a color changes, to refresh derived values
 };
 
 struct recidia_graphics_settings {
@@ -164,6 +195,7 @@ struct recidia_graphics_settings {
 struct recidia_misc_settings {
     bool settings_menu;
     bool frameless;
+    bool raw_terminal; // Escape sequences straight to the terminal instead of ncurses
 };
 
 // Global settings/data because it's used EVERYWHERE, passing is stupid
@@ -175,16 +207,61 @@ struct recidia_settings_struct {
 };
 extern struct recidia_settings_struct recidia_settings;
 
+// Audio reactive inputs published with the plots, relative to "height_cap" [0.0]-[1.0]
+// Same layout as the std140 "Audio" uniform block in shaders/recidia.glsl
+struct recidia_power_stats {
+    float main_power; // Mean of the main shader's "power_mod_range"
+    float back_power; // Mean of the back shader's "power_mod_range"
+    float mean;
+    float peak;
+    float bands[4]; // Mean of each quarter of the plots, low to high
+};
+
+// Plots published by processing, tagged with the count they were made for
+// Kept for a ring of frames, so renderers slower than processing can still see every one (spectrogram rows)
+const unsigned int PLOTS_FRAMES_COUNT = 32;
+struct recidia_plots_frame {
+    float *plots;
+    unsigned int plots_count;
+    struct recidia_power_stats power_stats;
+    u_int64_t time; // When the plots were published
+};
+
 struct recidia_data_struct {    
     unsigned int width, height;
     u_int64_t start_time;
     float latency;
     float frame_time;
-    unsigned int plots_count;
-    float *plots;
+    float gpu_back_time, gpu_main_time; // ms, rolling averages of each GUI pass
+    unsigned int drawn_plots_count; // In the last drawn frame, can lag behind requested_plots_count
+    // Posted (atomically) by the renderer, processing switches to it between frames
+    unsigned int requested_plots_count;
+    // Written in turn, the latest is "plots_frames[plots_sequence % PLOTS_FRAMES_COUNT]"
+    struct recidia_plots_frame plots_frames[PLOTS_FRAMES_COUNT];
+    u_int64_t plots_sequence; // Bumped (atomically) after new plots are published
+    u_int64_t plots_changed_sequence; // Posted (atomically) after plots that differ from the ones before
 };
 extern struct recidia_data_struct recidia_data;
 
+// The latest 2 published plots, renderers blend between them at their own frame rate
+struct recidia_plots_history {
+    std::vector<float> previous;
+    std::vector<float> current;
+    std::vector<float> next;
+    // Every plots published since the last update, oldest first, ending with the current plots
+    // Copied in before they are known to be whole, frames of another count are left out
+    std::vector<float> rows;
+    u_int64_t previous_time;
+    u_int64_t current_time;
+    u_int64_t sequence;
+    bool changing; // The previous plots differ from the current ones, so blending moves them
+    struct recidia_power_stats power_stats; // Of the current plots
+};
+void get_power_stats(const float *plots, unsigned int plots_count, recidia_power_stats &stats);
+bool update_plots_history(recidia_plots_history &history);
+float get_plots_blend(const recidia_plots_history &history, u_int64_t now);
+void blend_plots(const recidia_plots_history &history, float blend, float *plots);
+
 int get_setting_change(char key);
 void change_setting_by_key(char key);
 void limit_setting(float &setting, float min, float max);
@@ -195,9 +272,13 @@ void init_recidia_settings(int GUI);
 void get_config_settings(int GUI);
 
 void init_curses();
+void init_raw_terminal();
 
 void init_processing(recidia_audio_data *audio_data);
 
+int init_offline(int argc, char **argv);
+int init_offscreen(int argc, char **argv);
+
 u_int64_t utime_now();
 #endif
 
@@ -0,0 +1,179 @@
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include <vulkan/vulkan.h>
+
+#include <recidia.h>
+
+#pragma once
+
+// Vulkan drawing shared by the GUI's QVulkanWindow and the headless offscreen renderer
+
+// Every device function the renderers call
+#define RECIDIA_DEVICE_FUNCTIONS(F) \
+    F(vkDestroyDevice) \
+    F(vkGetDeviceQueue) \
+    F(vkDeviceWaitIdle) \
+    F(vkQueueSubmit) \
+    F(vkCreateShaderModule) \
+    F(vkDestroyShaderModule) \
+    F(vkCreatePipelineCache) \
+    F(vkDestroyPipelineCache) \
+    F(vkGetPipelineCacheData) \
+    F(vkCreatePipelineLayout) \
+    F(vkDestroyPipelineLayout) \
+    F(vkCreateGraphicsPipelines) \
+    F(vkDestroyPipeline) \
+    F(vkCreateBuffer) \
+    F(vkDestroyBuffer) \
+    F(vkGetBufferMemoryRequirements) \
+    F(vkBindBufferMemory) \
+    F(vkCreateImage) \
+    F(vkDestroyImage) \
+    F(vkGetImageMemoryRequirements) \
+    F(vkBindImageMemory) \
+    F(vkCreateImageView) \
+    F(vkDestroyImageView) \
+    F(vkAllocateMemory) \
+    F(vkFreeMemory) \
+    F(vkMapMemory) \
+    F(vkUnmapMemory) \
+    F(vkCreateDescriptorSetLayout) \
+    F(vkDestroyDescriptorSetLayout) \
+    F(vkCreateDescriptorPool) \
+    F(vkDestroyDescriptorPool) \
+    F(vkAllocateDescriptorSets) \
+    F(vkUpdateDescriptorSets) \
+    F(vkCreateRenderPass) \
+    F(vkDestroyRenderPass) \
+    F(vkCreateFramebuffer) \
+    F(vkDestroyFramebuffer) \
+    F(vkCreateCommandPool) \
+    F(vkDestroyCommandPool) \
+    F(vkAllocateCommandBuffers) \
+    F(vkBeginCommandBuffer) \
+    F(vkEndCommandBuffer) \
+    F(vkCreateFence) \
+    F(vkDestroyFence) \
+    F(vkWaitForFences) \
+    F(vkResetFences) \
+    F(vkCreateQueryPool) \
+    F(vkDestroyQueryPool) \
+    F(vkGetQueryPoolResults) \
+    F(vkCmdResetQueryPool) \
+    F(vkCmdWriteTimestamp) \
+    F(vkCmdBeginRenderPass) \
+    F(vkCmdEndRenderPass) \
+    F(vkCmdBindPipeline) \
+    F(vkCmdBindDescriptorSets) \
+    F(vkCmdPushConstants) \
+    F(vkCmdSetViewport) \
+    F(vkCmdSetScissor) \
+    F(vkCmdDraw) \
+    F(vkCreateSampler) \
+    F(vkDestroySampler) \
+    F(vkCmdCopyImageToBuffer) \
+    F(vkCmdCopyBufferToImage) \
+    F(vkCmdClearColorImage) \
+    F(vkCmdPipelineBarrier)
+
+// Loaded from whichever device is rendering, called like QVulkanDeviceFunctions
+struct VulkanDeviceFunctions {
+#define RECIDIA_DEVICE_FUNCTION_MEMBER(name) PFN_##name name = nullptr;
+    RECIDIA_DEVICE_FUNCTIONS(RECIDIA_DEVICE_FUNCTION_MEMBER)
+#undef RECIDIA_DEVICE_FUNCTION_MEMBER
+};
+
+// Only one device renders at a time
+extern VkDevice vulkan_dev;
+extern VulkanDeviceFunctions *dev_funct;
+bool init_render_device(VkDevice device, PFN_vkGetDeviceProcAddr get_device_proc_addr);
+
+// Same as QVulkanWindow::MAX_CONCURRENT_FRAME_COUNT
+const int RENDER_MAX_FRAMES = 3;
+
+// Plots heights read by the vertex shaders, a slice per frame in flight
+extern uint PLOTS_BUFFER_SIZE;
+void finalize_buffers_size();
+
+// One persistently mapped buffer, the CPU writes the current frame's slice while the GPU reads the others
+// Each slice has the current plots, the previous plots then the audio uniforms
+struct FrameResources {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    float *plots_slices[RENDER_MAX_FRAMES][2]; // Current and previous plots
+    void *audio_slices[RENDER_MAX_FRAMES]; // recidia_power_stats
+
+    VkDescriptorPool desc_pool = VK_NULL_HANDLE;
+    VkDescriptorSetLayout desc_set_layout = VK_NULL_HANDLE;
+    VkDescriptorSet desc_sets[RENDER_MAX_FRAMES];
+};
+void create_frame_resources(FrameResources &resources, int frames_count, const VkPhysicalDeviceLimits &limits,
+                            uint32_t memory_index);
+void release_frame_resources(FrameResources &resources);
+
+bool find_memory_type(const VkPhysicalDeviceMemoryProperties &properties, uint32_t type_bits,
+                      VkMemoryPropertyFlags flags, uint32_t &index);
+
+// User draw modes past "Bars"=0 and "Points"=1, see shaders/recidia.glsl
+const int DRAW_SPECTROGRAM = 2;
+const int DRAW_CURVE = 3;
+// Layouts, "Linear"=0
+const int LAYOUT_MIRRORED = 1;
+const int LAYOUT_RADIAL = 2;
+
+// "Spectrogram" draw mode, past spectra as rows of a ring texture resident on the GPU
+// Only the rows since the last frame are uploaded, shaders/spectrogram.vert scrolls by where the ring starts
+const uint SPECTROGRAM_ROWS = 1024;
+const uint SPECTROGRAM_UPLOAD_ROWS = PLOTS_FRAMES_COUNT; // At most per frame, older ones are dropped
+struct SpectrogramResources {
+    VkImage image = VK_NULL_HANDLE; // R8 unorm, relative to the height cap
+    VkDeviceMemory image_memory = VK_NULL_HANDLE;
+    VkImageView image_view = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+    uint32_t width = 0; // Plots a row can hold
+
+    VkBuffer staging = VK_NULL_HANDLE;
+    VkDeviceMemory staging_memory = VK_NULL_HANDLE;
+    unsigned char *row_slices[RENDER_MAX_FRAMES]; // SPECTROGRAM_UPLOAD_ROWS rows per frame in flight
+
+    uint32_t newest_row = 0;
+    uint columns = 0; // Plots in the rows, a change starts over
+    bool cleared = false; // Readable by the shaders
+};
+// Binds the texture in every frame's descriptor set
+void create_spectrogram(SpectrogramResources &spectrogram, FrameResources &resources, int frames_count,
+                        const VkPhysicalDeviceLimits &limits, const VkPhysicalDeviceMemoryProperties &memory_properties);
+void release_spectrogram(SpectrogramResources &spectrogram);
+// Recorded before the render pass, "rows" are "rows_count" spectra of "plots_count" plots, oldest first
+void push_spectrogram_rows(VkCommandBuffer &commandBuffer, SpectrogramResources &spectrogram, int frame,
+                           const float *rows, uint rows_count, uint plots_count);
+shader_setting get_spectrogram_shader();
+
+std::vector<std::string> get_shader_locations();
+bool is_animated_shader(const std::string &vertex, const std::string &frag);
+bool is_animated_shader(const shader_setting &shader);
+
+// Kept on disk between runs, see get_cache_dir()
+void create_pipeline_cache(const VkPhysicalDeviceProperties &properties);
+void release_pipeline_cache();
+
+void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, uint32_t memory_index, VkBuffer& buffer,
+                  VkDeviceMemory& bufferMemory);
+void createPipline(shader_setting shader, VkRenderPass render_pass, VkSampleCountFlagBits samples,
+                   VkDescriptorSetLayout descSetLayout, VkPipelineLayout &pipelineLayout, VkPipeline &pipeline);
+
+// Linear, alpha premultiplied
+void set_linear_color(float color[4], rgba_color srgb);
+
+// "time" is in us and animates the shaders, "width" and "height" are the target's in pixels
+void draw_background(VkCommandBuffer &commandBuffer, VkPipelineLayout &pipelineLayout, VkPipeline &pipeline,
+                     VkDescriptorSet &descSet, const recidia_plots_history &plots_history, const float color[4],
+                     u_int64_t time);
+void draw_plots(VkCommandBuffer &commandBuffer, VkPipelineLayout &pipelineLayout, VkPipeline &pipeline,
+                VkDescriptorSet &descSet, float *plots_slice[2], const recidia_plots_history &plots_history,
+                const float color[4], float width, float height, float blend, u_int64_t time);
+void draw_spectrogram(VkCommandBuffer &commandBuffer, VkPipelineLayout &pipelineLayout, VkPipeline &pipeline,
+                      VkDescriptorSet &descSet, const SpectrogramResources &spectrogram,
+                      const recidia_plots_history &plots_history, float width, u_int64_t time);
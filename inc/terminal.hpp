@@ -0,0 +1,48 @@
+#include <string>
+#include <sys/types.h>
+
+#include <recidia.h>
+
+#pragma once
+
+// Terminal output without ncurses, escape sequences written straight to stdout
+// A frame is built into one buffer and flushed with a single write(), inside a synchronized update
+// (DEC mode 2026) so terminals that support it never show half a frame
+
+// Keys past a char, from mouse wheel reports
+const int RAW_KEY_NONE = -1;
+const int RAW_KEY_SCROLL_UP = 0x100;
+const int RAW_KEY_SCROLL_DOWN = 0x101;
+
+struct RawTerminal {
+    uint width = 0, height = 0;
+
+    std::string frame; // Reserved for a whole screen on resize, so frames don't allocate
+    uint cursor_x = 0, cursor_y = 0; // Where the next glyph lands, moves there are skipped
+    bool cursor_known = false;
+
+    std::string colors; // From set_raw_colors()
+    const std::string *foreground = nullptr; // Last written by set_raw_foreground(), nullptr is "colors"
+
+    std::string input; // Incomplete escape sequences between reads
+};
+
+// Raw mode, alternate screen, hidden cursor and mouse wheel reports, undone at exit or on SIGINT/SIGTERM
+bool open_raw_terminal(RawTerminal &terminal);
+void close_raw_terminal(RawTerminal &terminal);
+// True if the size changed
+bool update_raw_terminal_size(RawTerminal &terminal);
+
+void begin_raw_frame(RawTerminal &terminal);
+void clear_raw_frame(RawTerminal &terminal);
+// Raw SGR parameters, like "38;2;255;255;255", empty resets
+void set_raw_colors(RawTerminal &terminal, const std::string &sgr);
+// Whole SGR sequence of the next glyphs' color, only written when it isn't the last one
+// Meant for tables built once, nullptr goes back to set_raw_colors()
+void set_raw_foreground(RawTerminal &terminal, const std::string *sequence);
+// Single width glyphs or text, clipped by the caller
+void draw_raw(RawTerminal &terminal, uint y, uint x, const char *text, uint columns);
+void flush_raw_frame(RawTerminal &terminal);
+
+// RAW_KEY_NONE once nothing is left to read
+int read_raw_key(RawTerminal &terminal);
@@ -1,25 +1,20 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec4 inColor;
+#include "recidia.glsl"
 
 layout(location = 0) out vec4 fragColor;
 
-layout(push_constant) uniform PushConstants {
-    float time;
-    float power;
-} constants;
-
 // Reduced init size of vertex to allow for room to bounce
 #define INIT_SIZE 0.75
 // Separate power modifier
 #define POWER 0.35
 
 void main() {
-    vec3 pos = inPosition;
+    vec3 pos = recidia_position();
     pos *= INIT_SIZE;
     pos *= 1.0 + (constants.power * POWER);
     
     gl_Position = vec4(pos, 1.0);
-    fragColor = inColor;
-}
\ No newline at end of file
+    fragColor = constants.color;
+}
@@ -1,11 +1,11 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec4 inColor;
+#include "recidia.glsl"
 
 layout(location = 0) out vec4 fragColor;
 
 void main() {
-    gl_Position = vec4(inPosition, 1.0);
-    fragColor = inColor;
+    gl_Position = vec4(recidia_position(), 1.0);
+    fragColor = constants.color;
 }
@@ -0,0 +1,156 @@
+// Shared by the vertex shaders, include with #include "recidia.glsl"
+// Plots are drawn as instances of a 6 vertex quad, positions come from the plots heights
+// A curve is instances of a strip of quads, one per pair of plots
+
+#define DRAW_BARS 0
+#define DRAW_POINTS 1
+#define DRAW_SPECTROGRAM 2
+#define DRAW_CURVE 3
+#define DRAW_BACKGROUND 4
+
+#define LAYOUT_LINEAR 0
+#define LAYOUT_MIRRORED 1
+#define LAYOUT_RADIAL 2
+
+layout(push_constant) uniform PushConstants {
+    float time;
+    float power;
+    uint plots_count;
+    int draw_mode;
+    vec4 color; // Linear, alpha premultiplied
+    vec2 origin; // Relative position of the first plot's bottom left
+    float plot_width; // Relative sizes
+    float step;
+    float height_scale; // Plots to relative height
+    float min_height;
+    float max_height;
+    float blend; // From the previous to the current plots [0.0]-[1.0]
+    uint newest_row; // Spectrogram ring's row of the current plots
+    uint curve_subdivisions; // Quads between each pair of plots
+    int plots_layout; // Where the plots go, applied after their linear positions
+    float inner_radius; // Radial, relative to the max height [0.0]-[1.0]
+    float start_angle; // Radial, radians clockwise from the top
+    float aspect; // Height over width in pixels, keeps radial round
+} constants;
+
+layout(std430, set = 0, binding = 0) readonly buffer Plots {
+    float heights[];
+} plots;
+
+layout(std430, set = 0, binding = 1) readonly buffer PreviousPlots {
+    float heights[];
+} previous_plots;
+
+// Computed with the plots, relative to the height cap [0.0]-[1.0]
+// Frag shaders can declare the same block to use it
+layout(std140, set = 0, binding = 2) uniform Audio {
+    float main_power; // Mean of the main shader's power modifier range
+    float back_power;
+    float mean;
+    float peak;
+    vec4 bands; // Mean of each quarter of the plots, low to high
+} audio;
+
+// Bottom left, bottom right, top right, top left
+const vec2 CORNERS[4] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+const int QUAD_CORNERS[6] = int[](0, 1, 2, 2, 3, 0);
+// Reversed winding, flipped copies would be culled otherwise
+const int MIRRORED_QUAD_CORNERS[6] = int[](2, 1, 0, 0, 3, 2);
+
+float recidia_plot_height(uint index) {
+    float height = mix(previous_plots.heights[index], plots.heights[index], constants.blend);
+    return clamp(height * constants.height_scale, constants.min_height, constants.max_height);
+}
+
+// [0.0]-[1.0] corner of the quad
+vec2 recidia_corner() {
+    return CORNERS[QUAD_CORNERS[gl_VertexIndex % 6]];
+}
+
+// Monotone cubic (Fritsch-Carlson) from plot "index" to the next, "t" [0.0]-[1.0]
+// Unlike Catmull-Rom it never overshoots the plots, so it stays within the min and max height
+float recidia_curve_height(uint index, float t) {
+    uint last = constants.plots_count - 1u;
+    float h0 = recidia_plot_height(index > 0u ? index - 1u : 0u);
+    float h1 = recidia_plot_height(index);
+    float h2 = recidia_plot_height(min(index + 1u, last));
+    float h3 = recidia_plot_height(min(index + 2u, last));
+
+    // Harmonic mean of the neighboring slopes, flat at peaks and valleys
+    float d0 = h1 - h0, d1 = h2 - h1, d2 = h3 - h2;
+    float m1 = (d0 * d1 > 0.0) ? (2.0 * d0 * d1) / (d0 + d1) : 0.0;
+    float m2 = (d1 * d2 > 0.0) ? (2.0 * d1 * d2) / (d1 + d2) : 0.0;
+
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return ((2.0*t3 - 3.0*t2 + 1.0) * h1) + ((t3 - 2.0*t2 + t) * m1)
+         + ((-2.0*t3 + 3.0*t2) * h2) + ((t3 - t2) * m2);
+}
+
+// Linear plots positions to the layout's
+vec2 recidia_layout(vec2 pos, bool flipped) {
+    vec2 rel = pos - constants.origin;
+    float span = float(constants.plots_count) * constants.step;
+
+    if (constants.plots_layout == LAYOUT_MIRRORED) {
+        // Half as wide each side, the first plots meet in the middle
+        float center = constants.origin.x + (span * 0.5);
+        pos.x = flipped ? center - (rel.x * 0.5) : center + (rel.x * 0.5);
+    }
+    else if (constants.plots_layout == LAYOUT_RADIAL) {
+        // Around a circle as tall as the max height, plots grow outward from the inner radius
+        float radius = constants.max_height * 0.5;
+        vec2 center = constants.origin + vec2(span * 0.5, radius);
+        float angle = constants.start_angle + ((rel.x / span) * 6.28318530718);
+        float height = rel.y / max(constants.max_height, 0.000001);
+        float plotRadius = radius * mix(constants.inner_radius, 1.0, height);
+
+        pos = center + vec2(sin(angle) * plotRadius * constants.aspect, cos(angle) * plotRadius);
+    }
+    return pos;
+}
+
+vec3 recidia_position() {
+    bool plotsMode = constants.draw_mode != DRAW_BACKGROUND && constants.draw_mode != DRAW_SPECTROGRAM;
+
+    // Mirrored draws the instances twice, the second half flipped
+    uint index = uint(gl_InstanceIndex);
+    uint instances = (constants.draw_mode == DRAW_CURVE) ? constants.plots_count - 1u : constants.plots_count;
+    bool flipped = plotsMode && constants.plots_layout == LAYOUT_MIRRORED && index >= instances;
+    if (flipped)
+        index -= instances;
+
+    int corner = QUAD_CORNERS[gl_VertexIndex % 6];
+    if (flipped)
+        corner = MIRRORED_QUAD_CORNERS[gl_VertexIndex % 6];
+    vec2 pos = CORNERS[corner];
+
+    if (constants.draw_mode == DRAW_BACKGROUND) {
+        pos = (pos * 2.0) - 1.0;
+    }
+    else if (constants.draw_mode == DRAW_SPECTROGRAM) {
+        // One quad over all the plots
+        pos.x = constants.origin.x + (pos.x * constants.plots_count * constants.step);
+        pos.y = constants.origin.y + (pos.y * constants.max_height);
+    }
+    else if (constants.draw_mode == DRAW_CURVE) {
+        // Filled down to the origin, from the center of a plot to the next
+        float t = (float(gl_VertexIndex / 6) + pos.x) / float(constants.curve_subdivisions);
+
+        pos.x = constants.origin.x + ((float(index) + t) * constants.step) + (constants.plot_width * 0.5);
+        pos.y = constants.origin.y + (pos.y * recidia_curve_height(index, t));
+    }
+    else {
+        float height = recidia_plot_height(index);
+        // Points connect to the next plot
+        if (corner == 2 && constants.draw_mode == DRAW_POINTS && index < constants.plots_count-1u)
+            height = recidia_plot_height(index+1u);
+
+        pos.x = constants.origin.x + (index * constants.step) + (pos.x * constants.plot_width);
+        pos.y = constants.origin.y + (pos.y * height);
+    }
+
+    if (plotsMode)
+        pos = recidia_layout(pos, flipped);
+    return vec3(pos.x, -pos.y, 0.0);
+}
@@ -0,0 +1,30 @@
+#version 450
+
+// Plots heights relative to the height cap [0.0]-[1.0]
+layout(set = 0, binding = 3) uniform sampler2D history;
+
+layout(location = 0) in vec2 historyCoord;
+layout(location = 0) out vec4 outColor;
+
+// Colormap LUT, evenly spaced sRGB stops from quiet to loud (inferno)
+const vec3 COLORMAP[8] = vec3[](
+    vec3(0.000, 0.000, 0.016),
+    vec3(0.157, 0.043, 0.329),
+    vec3(0.396, 0.082, 0.431),
+    vec3(0.624, 0.165, 0.388),
+    vec3(0.831, 0.282, 0.259),
+    vec3(0.961, 0.490, 0.082),
+    vec3(0.980, 0.757, 0.153),
+    vec3(0.988, 1.000, 0.643)
+);
+
+void main() {
+    float height = texture(history, historyCoord).r;
+
+    float position = height * float(COLORMAP.length() - 1);
+    int index = min(int(position), COLORMAP.length() - 2);
+    vec3 color = mix(COLORMAP[index], COLORMAP[index + 1], position - float(index));
+
+    // Linear output
+    outColor = vec4(pow(color, vec3(2.2)), 1.0);
+}
@@ -0,0 +1,19 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "recidia.glsl"
+
+// Ring of past plots, a row each, see shaders/spectrogram.frag
+layout(set = 0, binding = 3) uniform sampler2D history;
+
+layout(location = 0) out vec2 historyCoord;
+
+void main() {
+    gl_Position = vec4(recidia_position(), 1.0);
+
+    // Newest row on top, the oldest at the bottom, the sampler wraps around the ring
+    ivec2 size = textureSize(history, 0);
+    vec2 corner = recidia_corner();
+    historyCoord.x = corner.x * float(constants.plots_count) / float(size.x);
+    historyCoord.y = (float(constants.newest_row) + 0.5 - ((1.0 - corner.y) * float(size.y))) / float(size.y);
+}
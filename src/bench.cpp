@@ -0,0 +1,400 @@
+#include <unistd.h>
+#include <getopt.h>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <new>
+#include <vector>
+
+#include <fftw3.h>
+
+#include <librecidia.h>
+#include <processing.hpp>
+
+using namespace std;
+
+// Count every heap allocation, the malloc family (fftw_malloc is posix_memalign) and operator new
+static u_int64_t allocs_count = 0;
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+
+void *malloc(size_t size) {
+    allocs_count++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    allocs_count++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    allocs_count++;
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    allocs_count++;
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    allocs_count++;
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) {
+    // Power of 2 multiples of a pointer only
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+
+    allocs_count++;
+    void *allocation = __libc_memalign(alignment, size);
+    if (!allocation)
+        return ENOMEM;
+    *ptr = allocation;
+    return 0;
+}
+}
+
+// Through the counted malloc even if the C++ runtime wouldn't call it, the default deletes free() these
+void *operator new(size_t size) {
+    void *allocation = malloc(size ? size : 1);
+    if (!allocation)
+        throw bad_alloc();
+    return allocation;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, const nothrow_t&) noexcept {
+    return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const nothrow_t&) noexcept {
+    return malloc(size ? size : 1);
+}
+
+void *operator new(size_t size, align_val_t alignment) {
+    void *allocation = aligned_alloc((size_t) alignment, size ? size : 1);
+    if (!allocation)
+        throw bad_alloc();
+    return allocation;
+}
+
+void *operator new[](size_t size, align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+// Same as the default "Plot Chart Guide" in settings.cfg
+static const struct recidia_chart_guide BENCH_CHART_GUIDE = {0.0, 1.0, 1000.0, 0.66, 1.0, 12000.0};
+static const uint BENCH_SAMPLE_RATE = 48000;
+static const uint BENCH_POLY_ORDER = 3;
+
+static const uint BENCH_BUFFER_SIZES[] = {1024, 4096, 16384};
+static const uint BENCH_PLOTS_COUNTS[] = {64, 256, 1024};
+static const float BENCH_SAVGOL_WINDOWS[] = {0.05, 0.15, 0.3};
+static const uint BENCH_INTERPS[] = {2, 8, 32};
+
+struct bench_case {
+    const char *stage;
+    uint buffer_size; // 0 for not used
+    uint plots_count;
+    uint window_size;
+    uint interp;
+    const char *unit; // What the throughput counts
+    double units_per_op;
+};
+
+static u_int64_t min_time = 200000; // us per case
+static const char *stage_filter = NULL;
+
+static void print_header() {
+    printf("%-14s %7s %6s %7s %7s %12s %18s %10s\n",
+           "stage", "buffer", "plots", "window", "interp", "ns/op", "throughput", "allocs/op");
+}
+
+static void print_param(uint value, int width) {
+    if (value)
+        printf(" %*u", width, value);
+    else
+        printf(" %*s", width, "-");
+}
+
+static bool stage_enabled(const char *stage) {
+    return !stage_filter || strcmp(stage_filter, stage) == 0;
+}
+
+// Runs "op" in doubling batches until "min_time" has passed
+template<typename Op>
+static void run_case(const bench_case &bench, Op op) {
+    op(); // Warm up caches and any lazy allocations
+
+    u_int64_t opsCount = 0;
+    u_int64_t batchSize = 1;
+    u_int64_t allocsStart = allocs_count;
+    auto timerStart = chrono::steady_clock::now();
+    double elapsed = 0;
+
+    while (elapsed < min_time * 1000.0) {
+        for (u_int64_t i=0; i < batchSize; i++) {
+            op();
+        }
+        opsCount += batchSize;
+        batchSize *= 2;
+        elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - timerStart).count();
+    }
+    u_int64_t allocs = allocs_count - allocsStart;
+
+    double nsPerOp = elapsed / opsCount;
+    double throughput = bench.units_per_op / (nsPerOp / 1e9);
+
+    printf("%-14s", bench.stage);
+    print_param(bench.buffer_size, 7);
+    print_param(bench.plots_count, 6);
+    print_param(bench.window_size, 7);
+    print_param(bench.interp, 7);
+    printf(" %12.1f %11.2f M%s/s %10.2f\n", nsPerOp, throughput / 1e6, bench.unit, (double) allocs / opsCount);
+    fflush(stdout);
+}
+
+// A few tones and some noise, close to real audio for the FFT
+static void fill_signal(double *signal, uint size) {
+    srand(1);
+    for (uint i=0; i < size; i++) {
+        double t = (double) i / BENCH_SAMPLE_RATE;
+        signal[i] = 8000 * sin(2 * M_PI * 110 * t) + 4000 * sin(2 * M_PI * 880 * t)
+                  + 2000 * sin(2 * M_PI * 5000 * t) + (rand() % 2000) - 1000;
+    }
+}
+
+static void bench_chart_table() {
+    if (!stage_enabled("chart_table"))
+        return;
+
+    for (uint bufferSize : BENCH_BUFFER_SIZES) {
+        for (uint plotsCount : BENCH_PLOTS_COUNTS) {
+            if (plotsCount >= bufferSize / 2)
+                continue;
+
+            vector<uint> chartTable(plotsCount + 1);
+            bench_case bench = {"chart_table", bufferSize, plotsCount, 0, 0, "plot", (double) plotsCount};
+            run_case(bench, [&]() {
+                create_chart_table(plotsCount, chartTable.data(), BENCH_SAMPLE_RATE, bufferSize, BENCH_CHART_GUIDE);
+            });
+        }
+    }
+}
+
+static void bench_fft() {
+    if (!stage_enabled("fft"))
+        return;
+
+    for (uint bufferSize : BENCH_BUFFER_SIZES) {
+        double *fftIn = (double*) fftw_malloc(sizeof(double) * bufferSize);
+        double *fftOut = (double*) fftw_malloc(sizeof(double) * bufferSize);
+        fftw_plan fftPlan = fftw_plan_r2r_1d(bufferSize, fftIn, fftOut, FFTW_R2HC, FFTW_MEASURE);
+        fill_signal(fftIn, bufferSize);
+
+        bench_case bench = {"fft", bufferSize, 0, 0, 0, "sample", (double) bufferSize};
+        run_case(bench, [&]() {
+            fftw_execute(fftPlan);
+        });
+
+        fftw_destroy_plan(fftPlan);
+        fftw_free(fftIn);
+        fftw_free(fftOut);
+    }
+}
+
+// Normalizing and the chart table, FFT output is restored every op since it's changed in place
+static void bench_reduce() {
+    if (!stage_enabled("reduce"))
+        return;
+
+    for (uint bufferSize : BENCH_BUFFER_SIZES) {
+        double *fftIn = (double*) fftw_malloc(sizeof(double) * bufferSize);
+        double *fftOut = (double*) fftw_malloc(sizeof(double) * bufferSize);
+        fftw_plan fftPlan = fftw_plan_r2r_1d(bufferSize, fftIn, fftOut, FFTW_R2HC, FFTW_ESTIMATE);
+        fill_signal(fftIn, bufferSize);
+        fftw_execute(fftPlan);
+        vector<double> spectrum(fftOut, fftOut + bufferSize);
+
+        for (uint plotsCount : BENCH_PLOTS_COUNTS) {
+            if (plotsCount >= bufferSize / 2)
+                continue;
+
+            vector<uint> chartTable(plotsCount + 1);
+            create_chart_table(plotsCount, chartTable.data(), BENCH_SAMPLE_RATE, bufferSize, BENCH_CHART_GUIDE);
+            vector<float> plots(plotsCount);
+
+            bench_case bench = {"reduce", bufferSize, plotsCount, 0, 0, "bin", (double) bufferSize / 2};
+            run_case(bench, [&]() {
+                copy(spectrum.begin(), spectrum.end(), fftOut);
+                normalize_fft_output(fftOut, bufferSize);
+                apply_chart_table(fftOut, chartTable.data(), plotsCount, plots.data());
+            });
+        }
+
+        fftw_destroy_plan(fftPlan);
+        fftw_free(fftIn);
+        fftw_free(fftOut);
+    }
+}
+
+static void bench_savgol_coeffs() {
+    if (!stage_enabled("savgol_coeffs"))
+        return;
+
+    for (uint plotsCount : BENCH_PLOTS_COUNTS) {
+        for (float relativeWindowSize : BENCH_SAVGOL_WINDOWS) {
+            uint windowSize = get_savgol_window_size(relativeWindowSize, plotsCount, BENCH_POLY_ORDER);
+
+            bench_case bench = {"savgol_coeffs", 0, plotsCount, windowSize, 0, "coeff", (double) windowSize};
+            run_case(bench, [&]() {
+                vector<float> coeffs = get_savgol_coeffs(windowSize, BENCH_POLY_ORDER);
+            });
+        }
+    }
+}
+
+// Plots are restored every op since the filter works in place
+static void bench_savgol() {
+    if (!stage_enabled("savgol"))
+        return;
+
+    for (uint plotsCount : BENCH_PLOTS_COUNTS) {
+        vector<float> source(plotsCount);
+        for (uint i=0; i < plotsCount; i++) {
+            source[i] = 1000 + 500 * sin(i * 0.3) + (rand() % 100);
+        }
+        vector<float> plots(plotsCount);
+        vector<float> scratch;
+
+        for (float relativeWindowSize : BENCH_SAVGOL_WINDOWS) {
+            uint windowSize = get_savgol_window_size(relativeWindowSize, plotsCount, BENCH_POLY_ORDER);
+            vector<float> coeffs = get_savgol_coeffs(windowSize, BENCH_POLY_ORDER);
+
+            bench_case bench = {"savgol", 0, plotsCount, windowSize, 0, "plot", (double) plotsCount};
+            run_case(bench, [&]() {
+                copy(source.begin(), source.end(), plots.begin());
+                apply_savgol_filter(plots.data(), plotsCount, coeffs, scratch);
+            });
+        }
+    }
+}
+
+static void bench_interpolation() {
+    if (!stage_enabled("interpolation"))
+        return;
+
+    for (uint plotsCount : BENCH_PLOTS_COUNTS) {
+        for (uint interp : BENCH_INTERPS) {
+            vector<float> plots(plotsCount);
+            for (uint i=0; i < plotsCount; i++) {
+                plots[i] = 1000 + 500 * sin(i * 0.3);
+            }
+            vector<float> interpHistory(interp * plotsCount);
+            uint interpIndex = 0;
+
+            bench_case bench = {"interpolation", 0, plotsCount, 0, interp, "plot", (double) plotsCount};
+            run_case(bench, [&]() {
+                apply_interpolation(plots.data(), plotsCount, interpHistory.data(), plotsCount, interp, interpIndex);
+            });
+        }
+    }
+}
+
+// Every stage through the library, a hop of new samples per frame like the offline analysis
+static void bench_pipeline() {
+    if (!stage_enabled("pipeline"))
+        return;
+
+    for (uint bufferSize : BENCH_BUFFER_SIZES) {
+        vector<double> signal(bufferSize);
+        fill_signal(signal.data(), bufferSize);
+        vector<short> samples(signal.begin(), signal.end());
+        uint hopSize = bufferSize / 8;
+
+        for (uint plotsCount : BENCH_PLOTS_COUNTS) {
+            if (plotsCount >= bufferSize / 2)
+                continue;
+
+            recidia_pipeline_config config = {};
+            config.sample_rate = BENCH_SAMPLE_RATE;
+            config.buffer_size = bufferSize;
+            config.plots_count = plotsCount;
+            config.interp = 8;
+            config.savgol_window_size = 0.15;
+            config.savgol_poly_order = BENCH_POLY_ORDER;
+            config.chart_guide = BENCH_CHART_GUIDE;
+            config.measure_fft = 1;
+            recidia_pipeline *pipeline = recidia_pipeline_create(&config);
+            if (!pipeline) {
+                fprintf(stderr, "Error: Could not create the pipeline for buffer %u, %u plots\n", bufferSize, plotsCount);
+                continue;
+            }
+            vector<float> plots(plotsCount);
+            uint hopIndex = 0;
+
+            uint windowSize = get_savgol_window_size(config.savgol_window_size, plotsCount, BENCH_POLY_ORDER);
+            bench_case bench = {"pipeline", bufferSize, plotsCount, windowSize, config.interp, "frame", 1};
+            run_case(bench, [&]() {
+                recidia_pipeline_push(pipeline, samples.data() + (hopIndex * hopSize), hopSize);
+                recidia_pipeline_pull(pipeline, plots.data());
+                hopIndex = (hopIndex + 1) % 8;
+            });
+
+            recidia_pipeline_destroy(pipeline);
+        }
+    }
+}
+
+static void print_bench_usage() {
+    fprintf(stderr, "Usage: recidia-bench [options]\n"
+                    "  -s, --stage <name>  Only run one stage (chart_table, fft, reduce,\n"
+                    "                      savgol_coeffs, savgol, interpolation, pipeline)\n"
+                    "  -t, --time <ms>     Minimum time per case (default 200)\n");
+}
+
+int main(int argc, char **argv) {
+    static const struct option longOptions[] = {
+        {"stage", required_argument, NULL, 's'},
+        {"time", required_argument, NULL, 't'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "s:t:h", longOptions, NULL)) != -1) {
+        switch (opt) {
+            case 's':
+                stage_filter = optarg;
+                break;
+            case 't':
+                min_time = atoi(optarg) * 1000;
+                break;
+            default:
+                print_bench_usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    print_header();
+    bench_chart_table();
+    bench_fft();
+    bench_reduce();
+    bench_savgol_coeffs();
+    bench_savgol();
+    bench_interpolation();
+    bench_pipeline();
+
+    return EXIT_SUCCESS;
+}
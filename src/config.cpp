@@ -129,9 +129,27 @@ void change_setting_by_key(char key) {
             if (recidia_settings.design.draw_mode == 0)
                 recidia_settings.design.draw_mode = 1;
             else if (recidia_settings.design.draw_mode == 1)
+                recidia_settings.design.draw_mode = 2;
+            else if (recidia_settings.design.draw_mode == 2)
+                recidia_settings.design.draw_mode = 3;
+            else if (recidia_settings.design.draw_mode == 3)
                 recidia_settings.design.draw_mode = 0;
             break;
 
+        case LAYOUT_TOGGLE:
+            if (recidia_settings.design.layout < 2)
+                recidia_settings.design.layout += 1;
+            else
+                recidia_settings.design.layout = 0;
+            break;
+
+        case PLOT_GLYPHS_TOGGLE:
+            if (recidia_settings.design.plot_glyphs < 2)
+                recidia_settings.design.plot_glyphs += 1;
+            else
+                recidia_settings.design.plot_glyphs = 0;
+            break;
+
         case STATS_TOGGLE:
             if (recidia_settings.data.stats)
                 recidia_settings.data.stats = false;
@@ -159,17 +177,27 @@ void init_recidia_settings(int GUI) {
 
     recidia_settings.misc.settings_menu = true;
     recidia_settings.misc.frameless = false;
+    recidia_settings.misc.raw_terminal = false;
     recidia_settings.design.draw_x = -1.0;
     recidia_settings.design.draw_y = -1.0;
     recidia_settings.design.draw_width = 1.0;
     recidia_settings.design.draw_height = 1.0;
     recidia_settings.design.min_plot_height = 0.0;
     recidia_settings.design.draw_mode = 0;
+    recidia_settings.design.curve_subdivisions = 8;
+    recidia_settings.design.layout = 0;
+    recidia_settings.design.inner_radius = 0.3;
+    recidia_settings.design.start_angle = 0.0;
     recidia_settings.design.main_color = {255, 255, 255, 255};
     recidia_settings.design.back_color = {50, 50, 50, 150};
+    recidia_settings.design.colors_generation = 0;
     recidia_settings.graphics.main_shader = {NULL, NULL, 1500, 1.0, {0.0, 0.5}};
     recidia_settings.graphics.back_shader = {NULL, NULL, 1500, 1.0, {0.0, 0.5}};
     recidia_settings.design.draw_chars = NULL;
+    recidia_settings.design.plot_glyphs = 0;
+    recidia_settings.design.gradient_mode = 0;
+    recidia_settings.design.gradient_colors[0] = {0, 160, 255, 255};
+    recidia_settings.design.gradient_colors[1] = {255, 60, 120, 255};
     recidia_settings.data.height_cap = 500.0;
     recidia_settings.data.HEIGHT_CAP.MAX = 32768.0;
     recidia_settings.data.savgol_filter = {0.0, 3};
@@ -280,6 +308,14 @@ void get_config_settings(int GUI) {
                     set_const_key(confSetting, "toggle_key", FRAMELESS_TOGGLE);
                     break;
 
+                case str2int("Terminal Backend"):
+                {
+                    string backend;
+                    confSetting.lookupValue("backend", backend);
+                    recidia_settings.misc.raw_terminal = backend == "raw";
+                    break;
+                }
+
                 case str2int("Draw X"):
                     confSetting.lookupValue("default", recidia_settings.design.draw_x);
                     limit_setting(recidia_settings.design.draw_x, -1.0, 1.0);
@@ -338,6 +374,34 @@ void get_config_settings(int GUI) {
                     break;
                 }
 
+                case str2int("Plot Glyphs"):
+                    confSetting.lookupValue("glyphs", recidia_settings.design.plot_glyphs);
+                    limit_setting(recidia_settings.design.plot_glyphs, 0, 2);
+                    set_const_key(confSetting, "toggle_key", PLOT_GLYPHS_TOGGLE);
+                    break;
+
+                case str2int("Gradient"):
+                {
+                    confSetting.lookupValue("mode", recidia_settings.design.gradient_mode);
+                    limit_setting(recidia_settings.design.gradient_mode, 0, 2);
+
+                    string gradientEnds[] = {"start", "end"};
+                    for (uint i=0; i < 2; i++) {
+                        if (!confSetting.exists(gradientEnds[i]) || confSetting[gradientEnds[i]].getLength() < 3)
+                            continue;
+
+                        const libconfig::Setting &colorSetting = confSetting[gradientEnds[i]];
+                        int channels[3];
+                        for (uint j=0; j < 3; j++) {
+                            channels[j] = colorSetting[j];
+                            limit_setting(channels[j], 0, 255);
+                        }
+                        recidia_settings.design.gradient_colors[i] = {(uint) channels[0], (uint) channels[1],
+                                                                      (uint) channels[2], 255};
+                    }
+                    break;
+                }
+
                 case str2int("Data Height Cap"):
                     confSetting.lookupValue("default", recidia_settings.data.height_cap);
                     set_const_setting(&recidia_settings.data.HEIGHT_CAP, confSetting);
@@ -395,6 +459,7 @@ void get_config_settings(int GUI) {
                     limit_setting(recidia_settings.design.main_color.blue, 0, 255);
                     confSetting.lookupValue("alpha", recidia_settings.design.main_color.alpha);
                     limit_setting(recidia_settings.design.main_color.alpha, 0, 255);
+                    recidia_settings.design.colors_generation++;
                     break;
 
                 case str2int("Background Color"):
@@ -406,6 +471,7 @@ void get_config_settings(int GUI) {
                     limit_setting(recidia_settings.design.back_color.blue, 0, 255);
                     confSetting.lookupValue("alpha", recidia_settings.design.back_color.alpha);
                     limit_setting(recidia_settings.design.back_color.alpha, 0, 255);
+                    recidia_settings.design.colors_generation++;
                     break;
 
                 case str2int("Plot Chart Guide"):
@@ -420,10 +486,21 @@ void get_config_settings(int GUI) {
 
                 case str2int("Draw Mode"):
                     confSetting.lookupValue("mode", recidia_settings.design.draw_mode);
-                    limit_setting(recidia_settings.design.draw_mode, 0, 1);
+                    limit_setting(recidia_settings.design.draw_mode, 0, 3);
+                    confSetting.lookupValue("curve_subdivisions", recidia_settings.design.curve_subdivisions);
+                    limit_setting(recidia_settings.design.curve_subdivisions, 1, 64);
                     set_const_key(confSetting, "toggle_key", DRAW_MODE_TOGGLE);
                     break;
 
+                case str2int("Layout"):
+                    confSetting.lookupValue("layout", recidia_settings.design.layout);
+                    limit_setting(recidia_settings.design.layout, 0, 2);
+                    confSetting.lookupValue("inner_radius", recidia_settings.design.inner_radius);
+                    limit_setting(recidia_settings.design.inner_radius, 0.0, 1.0);
+                    confSetting.lookupValue("start_angle", recidia_settings.design.start_angle);
+                    set_const_key(confSetting, "toggle_key", LAYOUT_TOGGLE);
+                    break;
+
                 case str2int("Stats"):
                     confSetting.lookupValue("enabled", recidia_settings.data.stats);
                     set_const_key(confSetting, "toggle_key", STATS_TOGGLE);
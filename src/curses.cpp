@@ -1,14 +1,34 @@
 #include <unistd.h>
 #include <string>
 #include <cstring>
+#include <vector>
+#include <algorithm>
 #include <locale.h>
 
 #include <ncurses.h>
 
 #include <recidia.h>
+#include <terminal.hpp>
 
 using namespace std;
 
+// Escape sequences written straight to the terminal when set, else ncurses draws
+static RawTerminal *raw_terminal = NULL;
+
+// Plot glyphs past "Blocks"=0, the plot chars
+const int GLYPHS_BRAILLE = 1;
+const int GLYPHS_QUADRANTS = 2;
+
+// Truecolor gradients past "Off"=0, only drawn by "raw_terminal"
+const int GRADIENT_HEIGHT = 1;
+const int GRADIENT_FREQUENCY = 2;
+
+// Whole SGR sequences by row from the bottom or by plot, a cell's color is a lookup
+// Rebuilt with full redraws, after the frame's set_raw_colors() so no stale entry is cached
+static vector<string> gradient;
+static vector<uint> gradient_columns; // Plot of each column, by frequency
+static int gradient_mode = 0;
+
 static void set_colors() {
     if (recidia_settings.design.main_color.alpha || recidia_settings.design.back_color.alpha) {
         start_color();
@@ -36,6 +56,51 @@ static void set_colors() {
     }
 }
 
+// Truecolor SGR parameters of the colors with alpha, terminals without it ignore them
+static string get_raw_colors() {
+    string sgr;
+    const rgba_color &main = recidia_settings.design.main_color;
+    const rgba_color &back = recidia_settings.design.back_color;
+
+    if (main.alpha)
+        sgr += "38;2;" + to_string(main.red) + ";" + to_string(main.green) + ";" + to_string(main.blue);
+    if (back.alpha) {
+        if (!sgr.empty())
+            sgr += ";";
+        sgr += "48;2;" + to_string(back.red) + ";" + to_string(back.green) + ";" + to_string(back.blue);
+    }
+    return sgr;
+}
+
+// "columns" are the bars across a cell
+static void update_gradient(uint width, uint height, uint plots_count, uint plot_stride, uint columns) {
+    gradient.clear();
+    gradient_columns.clear();
+    gradient_mode = raw_terminal ? recidia_settings.design.gradient_mode : 0;
+    if (!gradient_mode)
+        return;
+
+    // A bar is one color, so its cells are runs
+    uint steps = height;
+    if (gradient_mode == GRADIENT_FREQUENCY) {
+        steps = max(plots_count, 1U);
+        for (uint x=0; x < width; x++) {
+            gradient_columns.push_back(min((x * columns) / plot_stride, steps - 1));
+        }
+    }
+    const rgba_color &start = recidia_settings.design.gradient_colors[0];
+    const rgba_color &end = recidia_settings.design.gradient_colors[1];
+
+    for (uint i=0; i < steps; i++) {
+        float t = (steps > 1) ? (float) i / (steps - 1) : 0.0;
+        uint red = start.red + (((float) end.red - start.red) * t) + 0.5;
+        uint green = start.green + (((float) end.green - start.green) * t) + 0.5;
+        uint blue = start.blue + (((float) end.blue - start.blue) * t) + 0.5;
+
+        gradient.push_back("\x1b[38;2;" + to_string(red) + ";" + to_string(green) + ";" + to_string(blue) + "m");
+    }
+}
+
 static string *get_draw_chars(uint *draw_slices) {
     // If none or less than 2 chars in draw_chars, force defaults
     if (recidia_settings.design.draw_chars == NULL) {
@@ -62,22 +127,174 @@ static string *get_draw_chars(uint *draw_slices) {
     return charList;
 }
 
-void init_curses() {
-    setlocale(LC_ALL, "");
-    initscr();
-    noecho();
-    nodelay(stdscr, TRUE);
-    curs_set(FALSE);
-    keypad(stdscr, TRUE);
-    mousemask(ALL_MOUSE_EVENTS, NULL);
-    mouseinterval(0); // No double click
+// Glyphs of a cell, looked up by how far up it the bars across it reach
+struct CellGlyphs {
+    uint columns; // Bars across a cell
+    uint levels; // Steps up a cell
+    vector<string> table; // Indexed by the left level * (levels + 1) + the right level
+};
+
+static CellGlyphs get_cell_glyphs(int mode, const string *char_list, uint draw_slices) {
+    CellGlyphs glyphs;
+
+    if (mode == GLYPHS_BRAILLE) {
+        // 2x4 dots, bits of the dots from the bottom up
+        const uint LEFT_DOTS[] = {0x40, 0x04, 0x02, 0x01};
+        const uint RIGHT_DOTS[] = {0x80, 0x20, 0x10, 0x08};
+        glyphs = {2, 4, {}};
+
+        for (uint left=0; left <= 4; left++) {
+            for (uint right=0; right <= 4; right++) {
+                uint dots = 0;
+                for (uint i=0; i < left; i++)
+                    dots |= LEFT_DOTS[i];
+                for (uint i=0; i < right; i++)
+                    dots |= RIGHT_DOTS[i];
+
+                // UTF-8 of U+2800 + dots, no dots is a space like the gaps
+                string glyph = " ";
+                if (dots)
+                    glyph = {(char) 0xE2, (char) (0xA0 | (dots >> 6)), (char) (0x80 | (dots & 0x3F))};
+                glyphs.table.push_back(glyph);
+            }
+        }
+    }
+    else if (mode == GLYPHS_QUADRANTS) {
+        glyphs = {2, 2, {" ", "▗", "▐",
+                         "▖", "▄", "▟",
+                         "▌", "▙", "█"}};
+    }
+    else {
+        glyphs = {1, draw_slices, vector<string>(char_list, char_list + draw_slices + 1)};
+    }
+    return glyphs;
+}
 
-    set_colors();
+// Levels of a bar "height" levels high, in the cell "row" cells up from the bottom
+static inline uint get_fill_level(uint height, uint row, uint levels) {
+    uint bottom = row * levels;
+    return height > bottom ? min(height - bottom, levels) : 0;
+}
+
+static inline uint get_cell_glyph(const CellGlyphs &glyphs, const uint *column_heights, uint row) {
+    uint glyph = get_fill_level(column_heights[0], row, glyphs.levels);
+    if (glyphs.columns == 2)
+        glyph = (glyph * (glyphs.levels + 1)) + get_fill_level(column_heights[1], row, glyphs.levels);
+    return glyph;
+}
+
+// Heights of every bar column across the screen, gaps are empty
+static void get_column_heights(const uint *plots, uint plots_count, uint plot_width, uint gap_width,
+                               vector<uint> &column_heights) {
+    fill(column_heights.begin(), column_heights.end(), 0);
+
+    uint column = 0;
+    for (uint i=0; i < plots_count && column < column_heights.size(); i++) {
+        for (uint j=0; j < plot_width && column < column_heights.size(); j++) {
+            column_heights[column++] = plots[i];
+        }
+        column += gap_width;
+    }
+}
+
+static void draw_cell(uint y, uint x, const CellGlyphs &glyphs, uint glyph) {
+    if (!raw_terminal) {
+        mvaddstr(y, x, glyphs.table[glyph].c_str());
+        return;
+    }
+
+    // The lowest glyph is empty, its color doesn't show so it doesn't break a run of one
+    if (glyph && !gradient.empty()) {
+        uint step = (gradient_mode == GRADIENT_HEIGHT) ? recidia_data.height - 1 - y : gradient_columns[x];
+        set_raw_foreground(*raw_terminal, &gradient[step]);
+    }
+    draw_raw(*raw_terminal, y, x, glyphs.table[glyph].c_str(), 1);
+}
+
+// ASCII text over the plots, clipped to the screen
+static void draw_text(uint y, uint x, const string &text) {
+    if (y >= (uint) recidia_data.height || x >= (uint) recidia_data.width)
+        return;
+
+    string clippedText = text.substr(0, recidia_data.width - x);
+    if (raw_terminal) {
+        set_raw_foreground(*raw_terminal, nullptr);
+        draw_raw(*raw_terminal, y, x, clippedText.c_str(), clippedText.length());
+    }
+    else
+        mvprintw(y, x, "%s", clippedText.c_str());
+}
+
+static void clear_screen() {
+    if (raw_terminal)
+        clear_raw_frame(*raw_terminal);
+    else
+        clear();
+}
+
+// Changes settings by key, the mouse wheel changes the height cap
+static void handle_input() {
+    int key;
+    bool scrollUp = false, scrollDown = false;
+
+    if (raw_terminal) {
+        key = read_raw_key(*raw_terminal);
+        scrollUp = key == RAW_KEY_SCROLL_UP;
+        scrollDown = key == RAW_KEY_SCROLL_DOWN;
+    }
+    else {
+        key = getch();
+        // Convert Mouse events to key
+        if (key == KEY_MOUSE) {
+            MEVENT mouseEvent;
+
+            if(getmouse(&mouseEvent) == OK) {
+                scrollUp = mouseEvent.bstate & BUTTON4_PRESSED;
+                scrollDown = mouseEvent.bstate & BUTTON5_PRESSED;
+            }
+        }
+    }
+
+    if (scrollUp) {
+        if (recidia_settings.data.height_cap > 1) {
+            recidia_settings.data.height_cap /= 1.25;
+
+            if (recidia_settings.data.height_cap < 1)
+                recidia_settings.data.height_cap = 1;
+        }
+    }
+    else if (scrollDown) {
+        if (recidia_settings.data.height_cap < recidia_settings.data.HEIGHT_CAP.MAX) {
+            recidia_settings.data.height_cap *= 1.25;
+
+            if (recidia_settings.data.height_cap > recidia_settings.data.HEIGHT_CAP.MAX)
+                recidia_settings.data.height_cap = recidia_settings.data.HEIGHT_CAP.MAX;
+        }
+    }
+    else if (key != KEY_MOUSE && key != RAW_KEY_SCROLL_UP && key != RAW_KEY_SCROLL_DOWN) {
+        change_setting_by_key(key);
+    }
+}
+
+// Every cell of a row, also covers text drawn over it
+static void draw_row(uint y, const vector<uint> &column_heights, const CellGlyphs &glyphs) {
+    uint row = recidia_data.height - 1 - y;
+
+    for (uint x=0; x < (uint) recidia_data.width; x++) {
+        draw_cell(y, x, glyphs, get_cell_glyph(glyphs, &column_heights[x * glyphs.columns], row));
+    }
+}
+
+// Draws frames through ncurses or "raw_terminal"
+static void run_terminal() {
+    string rawColors = get_raw_colors();
 
     // Initialize vars
-    uint i, j;
+    uint i;
     uint ceiling;
     uint finalPlots[recidia_settings.data.AUDIO_BUFFER_SIZE.MAX / 2];
+    float blendedPlots[recidia_settings.data.AUDIO_BUFFER_SIZE.MAX / 2];
+    recidia_plots_history plotsHistory = {};
     uint frameCount = 0;
     float realfps = 0;
 
@@ -88,7 +305,19 @@ void init_curses() {
     float savgolWindowSize = recidia_settings.data.savgol_filter.window_size;
     uint interp = recidia_settings.data.interp;
     uint audioBufferSize = recidia_settings.data.audio_buffer_size;
-    uint plotsCount = recidia_data.plots_count;
+    uint plotsCount = 0; // Of the drawn plots
+    uint width = 0, height = 0;
+
+    // What is on screen, only cells whose glyph changed are written so ncurses has little to diff
+    vector<uint> columnHeights;
+    vector<uint> drawnColumns;
+    bool redrawAll = true;
+    struct ChangedCell {
+        uint y, x, glyph;
+    };
+    vector<ChangedCell> changedCells; // Kept to not allocate every frame
+    vector<char> overlaidRows; // Text was drawn over them last frame
+    vector<char> textRows;
     uint fps = recidia_settings.design.fps_cap;
     uint poll_rate = recidia_settings.data.poll_rate;
 
@@ -99,11 +328,36 @@ void init_curses() {
     // Setup chars for drawing
     uint drawSlices = 0;
     string *charList = get_draw_chars(&drawSlices);
+    int plotGlyphs = recidia_settings.design.plot_glyphs;
+    CellGlyphs cellGlyphs = get_cell_glyphs(plotGlyphs, charList, drawSlices);
 
     while (1) {
         u_int64_t timerStart = utime_now();
-        getmaxyx(stdscr, recidia_data.height, recidia_data.width);
-        recidia_data.plots_count = (recidia_data.width / (recidia_settings.design.plot_width + recidia_settings.design.gap_width)) + 1;
+        if (raw_terminal) {
+            update_raw_terminal_size(*raw_terminal);
+            recidia_data.width = raw_terminal->width;
+            recidia_data.height = raw_terminal->height;
+
+            begin_raw_frame(*raw_terminal);
+            set_raw_colors(*raw_terminal, rawColors);
+        }
+        else {
+            getmaxyx(stdscr, recidia_data.height, recidia_data.width);
+        }
+        if (plotGlyphs != recidia_settings.design.plot_glyphs) {
+            plotGlyphs = recidia_settings.design.plot_glyphs;
+            cellGlyphs = get_cell_glyphs(plotGlyphs, charList, drawSlices);
+
+            timeOfDisplayed = 0;
+            const char *glyphsNames[] = {"Blocks", "Braille", "Quadrants"};
+            settingToDisplay = "Plot Glyphs " + string(glyphsNames[plotGlyphs]);
+
+            clear_screen();
+            redrawAll = true;
+        }
+        // Braille and quadrants fit 2 bars across a cell
+        uint requestedPlotsCount = ((recidia_data.width * cellGlyphs.columns) / (recidia_settings.design.plot_width + recidia_settings.design.gap_width)) + 1;
+        __atomic_store_n(&recidia_data.requested_plots_count, requestedPlotsCount, __ATOMIC_RELAXED);
 
         // Track setting changes
         if (plotHeightCap != recidia_settings.data.height_cap) {
@@ -118,7 +372,8 @@ void init_curses() {
             timeOfDisplayed = 0;
             settingToDisplay = "Plot Width " + to_string(plotWidth);
 
-            clear();
+            clear_screen();
+            redrawAll = true;
         }
         if (gapWidth != recidia_settings.design.gap_width) {
             gapWidth = recidia_settings.design.gap_width;
@@ -126,7 +381,8 @@ void init_curses() {
             timeOfDisplayed = 0;
             settingToDisplay = "Gap Width " + to_string(gapWidth);
 
-            clear();
+            clear_screen();
+            redrawAll = true;
         }
         if (savgolWindowSize != recidia_settings.data.savgol_filter.window_size) {
             savgolWindowSize = recidia_settings.data.savgol_filter.window_size;
@@ -158,54 +414,93 @@ void init_curses() {
             timeOfDisplayed = 0;
             settingToDisplay = "FPS Cap " + to_string(fps);
         }
-        if (plotsCount != recidia_data.plots_count) {
-            plotsCount = recidia_data.plots_count;
 
-            clear();
+        ceiling = recidia_data.height * cellGlyphs.levels;
+
+        // Smooth between processing frames
+        update_plots_history(plotsHistory);
+        blend_plots(plotsHistory, get_plots_blend(plotsHistory, utime_now()), blendedPlots);
+
+        // Only plots made for the requested count are taken, so the count changes with them
+        if (plotsCount != plotsHistory.current.size()) {
+            plotsCount = plotsHistory.current.size();
+
+            clear_screen();
+            redrawAll = true;
         }
+        if (width != (uint) recidia_data.width || height != (uint) recidia_data.height) {
+            width = recidia_data.width;
+            height = recidia_data.height;
 
-        ceiling = recidia_data.height * drawSlices;
+            clear_screen();
+            redrawAll = true;
+        }
 
         // Finalize plots height
         for (i=0; i < plotsCount; i++ ) {
 
             // Scale plots
-            finalPlots[i] = (recidia_data.plots[i] / plotHeightCap) * (float) ceiling;
+            finalPlots[i] = (blendedPlots[i] / plotHeightCap) * (float) ceiling;
             if (finalPlots[i] > ceiling) {
                 finalPlots[i] = ceiling;
             }
         }
 
         // Print plots/bars
-        for (uint y = 0; y < recidia_data.height; y++) {
-
-            uint limit = ceiling - (y * drawSlices);
-            string printBarLine;
-
-            for (i=0; i < plotsCount; i++) {
-
-                if (limit <= finalPlots[i]) {   // Full
-                    for (j=0; j < plotWidth; j++) {
-                        printBarLine += charList[drawSlices];
-                    }
-                }
-                else if ((limit - drawSlices) < finalPlots[i]) {  // Part
-                    for (j=0; j < plotWidth; j++) {
-                        printBarLine += charList[finalPlots[i] % drawSlices];
-                    }
-                }
-                else {   // Empty
-                    for (j=0; j < plotWidth; j++) {
-                        printBarLine += charList[0];
-                    }
+        overlaidRows.swap(textRows);
+        overlaidRows.resize(height, 0);
+        textRows.assign(height, 0);
+
+        if (redrawAll)
+            update_gradient(width, height, plotsCount, plotWidth + gapWidth, cellGlyphs.columns);
+        columnHeights.resize(width * cellGlyphs.columns);
+        get_column_heights(finalPlots, plotsCount, plotWidth, gapWidth, columnHeights);
+        for (uint y = 0; y < height; y++) {
+            if (redrawAll || overlaidRows[y])
+                draw_row(y, columnHeights, cellGlyphs);
+        }
+        if (!redrawAll) {
+            uint levels = cellGlyphs.levels;
+
+            for (uint x = 0; x < width; x++) {
+                const uint *oldHeights = &drawnColumns[x * cellGlyphs.columns];
+                const uint *newHeights = &columnHeights[x * cellGlyphs.columns];
+
+                bool changed = false;
+                uint lowHeight = ceiling, highHeight = 0;
+                for (uint c = 0; c < cellGlyphs.columns; c++) {
+                    changed |= oldHeights[c] != newHeights[c];
+                    lowHeight = min(lowHeight, min(oldHeights[c], newHeights[c]));
+                    highHeight = max(highHeight, max(oldHeights[c], newHeights[c]));
                 }
-                for (j=0; j < gapWidth; j++) {
-                    printBarLine += charList[0];
+                if (!changed)
+                    continue;
+
+                // Only the cells between the old and new tops can change
+                uint lowRow = lowHeight / levels;
+                uint highRow = min(highHeight / levels, height - 1);
+                for (uint row = lowRow; row <= highRow; row++) {
+                    uint newGlyph = get_cell_glyph(cellGlyphs, newHeights, row);
+                    uint y = height - 1 - row;
+
+                    if (!overlaidRows[y] && newGlyph != get_cell_glyph(cellGlyphs, oldHeights, row))
+                        changedCells.push_back({y, x, newGlyph});
                 }
+            }
 
+            // Row by row neighbouring cells skip the cursor move and colors only change between bars or rows
+            if (raw_terminal) {
+                sort(changedCells.begin(), changedCells.end(), [](const ChangedCell &a, const ChangedCell &b) {
+                    return a.y < b.y || (a.y == b.y && a.x < b.x);
+                });
+            }
+            for (const ChangedCell &cell : changedCells) {
+                draw_cell(cell.y, cell.x, cellGlyphs, cell.glyph);
             }
-            mvprintw(y, 0, "%s", printBarLine.c_str());
+            changedCells.clear();
         }
+        drawnColumns.swap(columnHeights);
+        redrawAll = false;
 
         // Show changes in settings on scrren
         if (settingToDisplay.compare("") != 0) {
@@ -214,7 +509,9 @@ void init_curses() {
             }
             if (timeOfDisplayed < SECONDS_TO_DISPLAY) {
                 uint printPos  = (recidia_data.width - settingToDisplay.length()) / 2;
-                mvprintw(recidia_data.height / 2, printPos, "%s" ,settingToDisplay.c_str());
+                draw_text(recidia_data.height / 2, printPos, settingToDisplay);
+                if (height)
+                    textRows[height / 2] = 1;
             }
             else {
                 settingToDisplay = "";
@@ -229,13 +526,21 @@ void init_curses() {
                 realfps = 1000 / recidia_data.frame_time;
             }
 
-            mvprintw(0, 0, "%s %.1fms", "Latency:" ,recidia_data.latency);
-            mvprintw(1, 0, "%s %.1f", "FPS:" ,realfps);
-            mvprintw(2, 0, "%s %i", "Plots:" ,plotsCount);
+            char statsText[3][64];
+            snprintf(statsText[0], sizeof(statsText[0]), "%s %.1fms", "Latency:" ,recidia_data.latency);
+            snprintf(statsText[1], sizeof(statsText[1]), "%s %.1f", "FPS:" ,realfps);
+            snprintf(statsText[2], sizeof(statsText[2]), "%s %i", "Plots:" ,plotsCount);
+            for (uint y = 0; y < 3 && y < height; y++) {
+                draw_text(y, 0, statsText[y]);
+                textRows[y] = 1;
+            }
         }
 
         // Draw frame
-        refresh(); 
+        if (raw_terminal)
+            flush_raw_frame(*raw_terminal);
+        else
+            refresh();
 
         frameCount += 1;
         if (frameCount > 1000000)
@@ -249,34 +554,34 @@ void init_curses() {
             usleep(1000);
 
             // Get input
-            int ch = getch();
-            // Convert Mouse events to key
-            if (ch == KEY_MOUSE) {
-                MEVENT mouseEvent;
-
-                if(getmouse(&mouseEvent) == OK) {
-                    if (mouseEvent.bstate & BUTTON4_PRESSED) { // Scroll Up
-                        if (recidia_settings.data.height_cap > 1) {
-                            recidia_settings.data.height_cap /= 1.25;
-
-                            if (recidia_settings.data.height_cap < 1)
-                                recidia_settings.data.height_cap = 1;
-                        }
-                    }
-                    else if (mouseEvent.bstate & BUTTON5_PRESSED) {  // Scroll Down
-                        if (recidia_settings.data.height_cap < recidia_settings.data.HEIGHT_CAP.MAX) {
-                            recidia_settings.data.height_cap *= 1.25;
-
-                            if (recidia_settings.data.height_cap > recidia_settings.data.HEIGHT_CAP.MAX)
-                                recidia_settings.data.height_cap = recidia_settings.data.HEIGHT_CAP.MAX;
-                        }
-                    }
-                }
-            }
-            else {
-                change_setting_by_key(ch);
-            }
+            handle_input();
         }
         recidia_data.frame_time = (float) (utime_now() - timerStart) / 1000;
     }
 }
+
+void init_curses() {
+    setlocale(LC_ALL, "");
+    initscr();
+    noecho();
+    nodelay(stdscr, TRUE);
+    curs_set(FALSE);
+    keypad(stdscr, TRUE);
+    mousemask(ALL_MOUSE_EVENTS, NULL);
+    mouseinterval(0); // No double click
+
+    set_colors();
+
+    run_terminal();
+}
+
+void init_raw_terminal() {
+    static RawTerminal terminal;
+    if (!open_raw_terminal(terminal)) {
+        fprintf(stderr, "Error: The raw terminal backend needs a terminal\n");
+        exit(EXIT_FAILURE);
+    }
+    raw_terminal = &terminal;
+
+    run_terminal();
+}
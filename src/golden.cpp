@@ -0,0 +1,421 @@
+#include <unistd.h>
+#include <getopt.h>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <recidia.h>
+
+using namespace std;
+
+static const uint GOLDEN_SAMPLE_RATE = 48000;
+static const uint GOLDEN_SAMPLES_COUNT = GOLDEN_SAMPLE_RATE * 3; // Covers every frame of the biggest buffer
+static const uint GOLDEN_FRAMES_COUNT = 40; // Enough to wrap the deepest interpolation
+
+static const char *GOLDEN_SIGNALS[] = {"sweep", "tones", "impulses"};
+
+struct golden_chart_guide {
+    const char *name;
+    struct recidia_chart_guide guide;
+};
+static const golden_chart_guide GOLDEN_CHART_GUIDES[] = {
+    {"default", {0.0, 1.0, 1000.0, 0.66, 1.0, 12000.0}},
+    {"linear", {20.0, 1.0, 10000.0, 0.5, 1.0, 20000.0}},
+    {"bass", {0.0, 0.5, 250.0, 0.5, 1.5, 4000.0}}
+};
+
+// Every combination is a case, poly orders only with a savgol window
+struct golden_grid {
+    vector<uint> buffer_sizes;
+    vector<uint> plots_counts;
+    vector<const golden_chart_guide*> chart_guides;
+    vector<float> savgol_windows;
+    vector<uint> poly_orders;
+    vector<uint> interps;
+};
+static const golden_grid GOLDEN_GRID = {
+    {1024, 4096, 16384},
+    {64, 400},
+    {&GOLDEN_CHART_GUIDES[0], &GOLDEN_CHART_GUIDES[1], &GOLDEN_CHART_GUIDES[2]},
+    {0.0, 0.1, 0.3},
+    {2, 3, 5},
+    {0, 1, 8, 32}
+};
+// Small enough to keep in the repo, tests/golden is checked by "meson test"
+static const golden_grid GOLDEN_QUICK_GRID = {
+    {4096},
+    {64},
+    {&GOLDEN_CHART_GUIDES[0]},
+    {0.0, 0.3},
+    {2, 3, 5},
+    {0, 8}
+};
+
+struct golden_case {
+    string name;
+    const char *signal;
+    uint buffer_size;
+    uint hop_size;
+    uint plots_count;
+    float savgol_window_size; // Relative
+    uint savgol_poly_order;
+    uint interp;
+    const golden_chart_guide *chart_guide;
+};
+
+struct golden_tolerance {
+    float rtol;
+    float atol;
+};
+
+// Deterministic so the goldens never depend on the libc rand()
+static uint golden_random(uint &state) {
+    state = state * 1664525 + 1013904223;
+    return state >> 16;
+}
+
+static void create_signal(const char *signal, vector<short> &samples) {
+    samples.assign(GOLDEN_SAMPLES_COUNT, 0);
+    uint state = 1;
+
+    for (uint i=0; i < GOLDEN_SAMPLES_COUNT; i++) {
+        double t = (double) i / GOLDEN_SAMPLE_RATE;
+        double sample = 0;
+
+        if (!strcmp(signal, "sweep")) {
+            // Log sweep from 20Hz to 20kHz over the whole signal
+            double duration = (double) GOLDEN_SAMPLES_COUNT / GOLDEN_SAMPLE_RATE;
+            double rate = log(20000.0 / 20.0) / duration;
+            sample = 12000 * sin(2 * M_PI * 20 * (exp(rate * t) - 1) / rate);
+        }
+        else if (!strcmp(signal, "tones")) {
+            sample = 6000 * sin(2 * M_PI * 60 * t) + 4000 * sin(2 * M_PI * 440 * t)
+                   + 3000 * sin(2 * M_PI * 3000 * t) + 2000 * sin(2 * M_PI * 9000 * t)
+                   + (int) (golden_random(state) % 1000) - 500;
+        }
+        else if (!strcmp(signal, "impulses")) {
+            if (i % (GOLDEN_SAMPLE_RATE / 10) == 0)
+                sample = 30000;
+        }
+        samples[i] = sample;
+    }
+}
+
+static vector<golden_case> get_golden_cases(const golden_grid &grid) {
+    vector<golden_case> cases;
+    char name[128];
+
+    for (const char *signal : GOLDEN_SIGNALS) {
+        for (uint bufferSize : grid.buffer_sizes) {
+            for (uint plotsCount : grid.plots_counts) {
+                if (plotsCount >= bufferSize / 2)
+                    continue;
+
+                for (const golden_chart_guide *chartGuide : grid.chart_guides) {
+                    for (float savgolWindowSize : grid.savgol_windows) {
+                        // The order means nothing without smoothing, stored as 0
+                        vector<uint> polyOrders = grid.poly_orders;
+                        if (!savgolWindowSize)
+                            polyOrders = {0};
+
+                        for (uint polyOrder : polyOrders) {
+                            for (uint interp : grid.interps) {
+                                snprintf(name, sizeof(name), "%s_b%u_p%u_%s_s%.2f_o%u_i%u", signal, bufferSize,
+                                         plotsCount, chartGuide->name, savgolWindowSize, polyOrder, interp);
+
+                                golden_case goldenCase = {name, signal, bufferSize, bufferSize / 8, plotsCount,
+                                                          savgolWindowSize, polyOrder, interp, chartGuide};
+                                cases.push_back(goldenCase);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return cases;
+}
+
+// Frame "i" is the audio buffer that starts at sample i * hop_size
+static bool run_pipeline(const golden_case &golden, const vector<short> &samples, vector<float> &frames) {
+    recidia_pipeline_config config = {};
+    config.sample_rate = GOLDEN_SAMPLE_RATE;
+    config.buffer_size = golden.buffer_size;
+    config.plots_count = golden.plots_count;
+    config.interp = golden.interp;
+    config.savgol_window_size = golden.savgol_window_size;
+    config.savgol_poly_order = golden.savgol_poly_order;
+    config.chart_guide = golden.chart_guide->guide;
+    config.measure_fft = 0; // Measured plans can pick a different algorithm from run to run
+
+    recidia_pipeline *pipeline = recidia_pipeline_create(&config);
+    if (!pipeline) {
+        fprintf(stderr, "Error: Could not create the pipeline for %s\n", golden.name.c_str());
+        return false;
+    }
+
+    frames.resize(GOLDEN_FRAMES_COUNT * golden.plots_count);
+    recidia_pipeline_push(pipeline, samples.data(), golden.buffer_size);
+    for (uint f=0; f < GOLDEN_FRAMES_COUNT; f++) {
+        if (f)
+            recidia_pipeline_push(pipeline, samples.data() + golden.buffer_size + ((f-1) * golden.hop_size), golden.hop_size);
+
+        recidia_pipeline_pull(pipeline, frames.data() + (f * golden.plots_count));
+    }
+    recidia_pipeline_destroy(pipeline);
+
+    return true;
+}
+
+static void fill_header(recidia_spectrum_header &header, const golden_case &golden, u_int64_t frames_count) {
+    header = {};
+    memcpy(header.magic, RECIDIA_SPECTRUM_MAGIC, sizeof(RECIDIA_SPECTRUM_MAGIC));
+    header.version = RECIDIA_SPECTRUM_VERSION;
+    header.header_size = sizeof(recidia_spectrum_header);
+    header.sample_rate = GOLDEN_SAMPLE_RATE;
+    header.hop_size = golden.hop_size;
+    header.buffer_size = golden.buffer_size;
+    header.plots_count = golden.plots_count;
+    header.frames_count = frames_count;
+    header.interp = golden.interp;
+    header.savgol_window_size = golden.savgol_window_size;
+    header.savgol_poly_order = golden.savgol_poly_order;
+
+    const struct recidia_chart_guide &guide = golden.chart_guide->guide;
+    header.chart_guide[0] = guide.start_freq;
+    header.chart_guide[1] = guide.start_ctrl;
+    header.chart_guide[2] = guide.mid_freq;
+    header.chart_guide[3] = guide.mid_pos;
+    header.chart_guide[4] = guide.end_ctrl;
+    header.chart_guide[5] = guide.end_freq;
+}
+
+static bool write_spectrum_file(const string &path, const recidia_spectrum_header &header, const vector<float> &frames) {
+    ofstream file(path, ios::binary | ios::trunc);
+    if (!file.is_open()) {
+        fprintf(stderr, "Error: Could not create \"%s\"\n", path.c_str());
+        return false;
+    }
+    file.write((const char*) &header, sizeof(header));
+    file.write((const char*) frames.data(), frames.size() * sizeof(float));
+
+    return file.good();
+}
+
+static bool read_spectrum_file(const string &path, recidia_spectrum_header &header, vector<float> &frames) {
+    ifstream file(path, ios::binary);
+    if (!file.is_open()) {
+        fprintf(stderr, "Error: Could not open \"%s\"\n", path.c_str());
+        return false;
+    }
+    file.read((char*) &header, sizeof(header));
+    if (!file || memcmp(header.magic, RECIDIA_SPECTRUM_MAGIC, sizeof(RECIDIA_SPECTRUM_MAGIC)) != 0) {
+        fprintf(stderr, "Error: \"%s\" is not a spectrum file\n", path.c_str());
+        return false;
+    }
+    if (header.version != RECIDIA_SPECTRUM_VERSION) {
+        fprintf(stderr, "Error: \"%s\" is version %u, expected %u\n", path.c_str(), header.version, RECIDIA_SPECTRUM_VERSION);
+        return false;
+    }
+
+    frames.resize(header.frames_count * header.plots_count);
+    file.seekg(header.header_size);
+    file.read((char*) frames.data(), frames.size() * sizeof(float));
+    if (!file) {
+        fprintf(stderr, "Error: \"%s\" is truncated\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Made with other parameters, the plots don't mean the same
+static bool compare_headers(const char *name, const recidia_spectrum_header &golden_header,
+                            const recidia_spectrum_header &header) {
+    if (golden_header.plots_count != header.plots_count || golden_header.frames_count != header.frames_count) {
+        printf("FAIL %s: %llu frames of %u plots, golden has %llu frames of %u plots\n", name,
+               (unsigned long long) header.frames_count, header.plots_count,
+               (unsigned long long) golden_header.frames_count, golden_header.plots_count);
+        return false;
+    }
+    if (golden_header.sample_rate != header.sample_rate || golden_header.hop_size != header.hop_size
+        || golden_header.buffer_size != header.buffer_size) {
+        printf("FAIL %s: %u Hz, hop %u, buffer %u, golden has %u Hz, hop %u, buffer %u\n", name,
+               header.sample_rate, header.hop_size, header.buffer_size,
+               golden_header.sample_rate, golden_header.hop_size, golden_header.buffer_size);
+        return false;
+    }
+    if (golden_header.interp != header.interp || golden_header.savgol_window_size != header.savgol_window_size
+        || golden_header.savgol_poly_order != header.savgol_poly_order) {
+        printf("FAIL %s: interp %u, savgol %g order %u, golden has interp %u, savgol %g order %u\n", name,
+               header.interp, header.savgol_window_size, header.savgol_poly_order,
+               golden_header.interp, golden_header.savgol_window_size, golden_header.savgol_poly_order);
+        return false;
+    }
+    for (uint i=0; i < 6; i++) {
+        if (golden_header.chart_guide[i] != header.chart_guide[i]) {
+            printf("FAIL %s: chart guide value %u is %g, golden has %g\n", name, i,
+                   header.chart_guide[i], golden_header.chart_guide[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Prints the worst plot and returns false if the headers differ or any plots are out of tolerance
+static bool compare_frames(const char *name, const recidia_spectrum_header &golden_header, const vector<float> &golden,
+                           const recidia_spectrum_header &header, const vector<float> &frames,
+                           const golden_tolerance &tolerance) {
+    if (!compare_headers(name, golden_header, header))
+        return false;
+
+    uint failedCount = 0;
+    size_t worstIndex = 0;
+    float worstError = 0;
+    for (size_t i=0; i < frames.size(); i++) {
+        float error = fabs(frames[i] - golden[i]);
+        float allowed = tolerance.atol + tolerance.rtol * max(fabs(frames[i]), fabs(golden[i]));
+
+        // NaNs never compare, so check it passes rather than fails
+        if (!(error <= allowed)) {
+            failedCount++;
+            if (failedCount == 1 || error > worstError) {
+                worstError = error;
+                worstIndex = i;
+            }
+        }
+    }
+
+    if (failedCount) {
+        printf("FAIL %s: %u plots out of tolerance, worst frame %zu plot %zu got %g expected %g\n", name, failedCount,
+               worstIndex / header.plots_count, worstIndex % header.plots_count, frames[worstIndex], golden[worstIndex]);
+        return false;
+    }
+    return true;
+}
+
+// "write" stores the synthetic goldens, "check" recomputes and compares against them
+static int run_golden_cases(const char *dir, bool write, const golden_grid &grid, const golden_tolerance &tolerance) {
+    if (write) {
+        try {
+            filesystem::create_directories(dir);
+        }
+        catch (filesystem::filesystem_error const& ex) {
+            fprintf(stderr, "Error: %s\n", ex.what());
+            return EXIT_FAILURE;
+        }
+    }
+
+    map<string, vector<short>> signals;
+    for (const char *signal : GOLDEN_SIGNALS) {
+        create_signal(signal, signals[signal]);
+    }
+
+    vector<golden_case> cases = get_golden_cases(grid);
+    uint failedCount = 0;
+    vector<float> frames, goldenFrames;
+    for (const golden_case &golden : cases) {
+        if (!run_pipeline(golden, signals[golden.signal], frames)) {
+            failedCount++;
+            continue;
+        }
+
+        recidia_spectrum_header header;
+        fill_header(header, golden, GOLDEN_FRAMES_COUNT);
+        string path = string(dir) + "/" + golden.name + ".rsf";
+
+        if (write) {
+            if (!write_spectrum_file(path, header, frames))
+                failedCount++;
+        }
+        else {
+            recidia_spectrum_header goldenHeader;
+            if (!read_spectrum_file(path, goldenHeader, goldenFrames)
+                || !compare_frames(golden.name.c_str(), goldenHeader, goldenFrames, header, frames, tolerance))
+                failedCount++;
+        }
+    }
+
+    printf("%zu cases, %u failed\n", cases.size(), failedCount);
+    return failedCount ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Compares spectrum files, e.g. "recidia --batch" output of real recordings from two builds
+static int compare_spectrum_paths(const char *golden_path, const char *path, const golden_tolerance &tolerance) {
+    vector<pair<string, string>> files;
+    if (filesystem::is_directory(golden_path)) {
+        for (const auto &entry : filesystem::recursive_directory_iterator(golden_path)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".rsf")
+                files.push_back({entry.path(), filesystem::path(path) / filesystem::relative(entry.path(), golden_path)});
+        }
+    }
+    else {
+        files.push_back({golden_path, path});
+    }
+
+    uint failedCount = 0;
+    recidia_spectrum_header goldenHeader, header;
+    vector<float> goldenFrames, frames;
+    for (const auto &file : files) {
+        if (!read_spectrum_file(file.first, goldenHeader, goldenFrames) || !read_spectrum_file(file.second, header, frames)
+            || !compare_frames(file.second.c_str(), goldenHeader, goldenFrames, header, frames, tolerance))
+            failedCount++;
+    }
+
+    printf("%zu files, %u failed\n", files.size(), failedCount);
+    return failedCount ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static void print_golden_usage() {
+    fprintf(stderr, "Usage: recidia-golden [options] write <dir>\n"
+                    "       recidia-golden [options] check <dir>\n"
+                    "       recidia-golden [options] compare <golden .rsf or dir> <.rsf or dir>\n"
+                    "  -q, --quick         Only the small grid of cases kept in tests/golden\n"
+                    "  -r, --rtol <value>  Relative tolerance (default 0.001)\n"
+                    "  -a, --atol <value>  Absolute tolerance (default 0.01)\n");
+}
+
+int main(int argc, char **argv) {
+    golden_tolerance tolerance = {0.001, 0.01};
+    const golden_grid *grid = &GOLDEN_GRID;
+
+    static const struct option longOptions[] = {
+        {"quick", no_argument, NULL, 'q'},
+        {"rtol", required_argument, NULL, 'r'},
+        {"atol", required_argument, NULL, 'a'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "qr:a:h", longOptions, NULL)) != -1) {
+        switch (opt) {
+            case 'q':
+                grid = &GOLDEN_QUICK_GRID;
+                break;
+            case 'r':
+                tolerance.rtol = atof(optarg);
+                break;
+            case 'a':
+                tolerance.atol = atof(optarg);
+                break;
+            default:
+                print_golden_usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    int argsCount = argc - optind;
+    char **args = argv + optind;
+    if (argsCount == 2 && !strcmp(args[0], "write"))
+        return run_golden_cases(args[1], true, *grid, tolerance);
+    if (argsCount == 2 && !strcmp(args[0], "check"))
+        return run_golden_cases(args[1], false, *grid, tolerance);
+    if (argsCount == 3 && !strcmp(args[0], "compare"))
+        return compare_spectrum_paths(args[1], args[2], tolerance);
+
+    print_golden_usage();
+    return EXIT_FAILURE;
+}
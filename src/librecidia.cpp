@@ -0,0 +1,312 @@
+#include <unistd.h>
+#include <cstring>
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include <fftw3.h>
+
+#include <librecidia.h>
+#include <processing.hpp>
+
+using namespace std;
+
+struct recidia_pipeline {
+    recidia_pipeline_config config = {};
+
+    fftw_plan fft_plan = NULL;
+    double *fft_in = NULL;
+    double *fft_out = NULL;
+
+    // Ring of the latest "buffer_size" samples, "samples_pos" is the oldest
+    vector<short> samples;
+    size_t samples_pos = 0;
+
+    vector<uint> chart_table;
+    uint savgol_window_size = 0;
+    vector<float> savgol_coeffs;
+    vector<float> savgol_scratch;
+    vector<float> interp_history;
+    u_int64_t frame_index = 0;
+};
+
+// What a config change may rebuild, the parts not built are kept from "base"
+// Holds the pipeline's old tables once installed
+struct recidia_pipeline_tables {
+    recidia_pipeline_config config = {};
+    recidia_pipeline_config base = {};
+    bool based = false;
+
+    bool fft_built = false;
+    fftw_plan fft_plan = NULL;
+    double *fft_in = NULL;
+    double *fft_out = NULL;
+
+    bool chart_built = false;
+    vector<uint> chart_table;
+
+    bool savgol_built = false;
+    uint savgol_window_size = 0;
+    vector<float> savgol_coeffs;
+};
+
+// The FFTW planner isn't thread safe, executing plans is
+static mutex fft_planner_lock;
+
+static bool is_valid_config(const recidia_pipeline_config &config) {
+    return config.sample_rate > 0 && config.buffer_size >= 4 && config.plots_count > 0;
+}
+
+static void clamp_config(recidia_pipeline_config &config) {
+    float maxFreq = (float) config.sample_rate / 2;
+    config.chart_guide.start_freq = clamp(config.chart_guide.start_freq, 0.0f, maxFreq);
+    config.chart_guide.mid_freq = clamp(config.chart_guide.mid_freq, 0.0f, maxFreq);
+    config.chart_guide.end_freq = clamp(config.chart_guide.end_freq, 0.0f, maxFreq);
+    config.chart_guide.mid_pos = clamp(config.chart_guide.mid_pos, 0.0f, 1.0f);
+    config.savgol_window_size = clamp(config.savgol_window_size, 0.0f, 1.0f);
+}
+
+static uint get_pipeline_savgol_window_size(const recidia_pipeline_config &config) {
+    uint windowSize = get_savgol_window_size(config.savgol_window_size, config.plots_count, config.savgol_poly_order);
+    // Can't pad a window bigger than the plots
+    if (windowSize > config.plots_count)
+        windowSize = 0;
+    return windowSize;
+}
+
+static void create_fft_plan(recidia_pipeline_tables *tables, uint buffer_size, int measure) {
+    lock_guard<mutex> guard(fft_planner_lock);
+
+    tables->fft_in = (double*) fftw_malloc(sizeof(double) * buffer_size);
+    tables->fft_out = (double*) fftw_malloc(sizeof(double) * buffer_size);
+    tables->fft_plan = fftw_plan_r2r_1d(buffer_size, tables->fft_in, tables->fft_out, FFTW_R2HC,
+                                        measure ? FFTW_MEASURE : FFTW_ESTIMATE);
+}
+
+static void destroy_fft_plan(fftw_plan plan, double *fft_in, double *fft_out) {
+    if (plan) {
+        lock_guard<mutex> guard(fft_planner_lock);
+        fftw_destroy_plan(plan);
+    }
+    fftw_free(fft_in);
+    fftw_free(fft_out);
+}
+
+// The slow part of a config change, FFTW planning can take a while when measuring
+static void build_tables(recidia_pipeline_tables *tables) {
+    const recidia_pipeline_config &config = tables->config;
+    const recidia_pipeline_config &old = tables->base;
+    bool all = !tables->based;
+
+    bool bufferChange = all || config.buffer_size != old.buffer_size;
+    bool plotsChange = all || config.plots_count != old.plots_count;
+    bool chartChange = bufferChange || plotsChange || config.sample_rate != old.sample_rate
+                       || memcmp(&config.chart_guide, &old.chart_guide, sizeof(config.chart_guide)) != 0;
+    bool savgolChange = plotsChange || config.savgol_window_size != old.savgol_window_size
+                        || config.savgol_poly_order != old.savgol_poly_order;
+
+    if (bufferChange || config.measure_fft != old.measure_fft) {
+        create_fft_plan(tables, config.buffer_size, config.measure_fft);
+        tables->fft_built = true;
+    }
+
+    if (chartChange) {
+        tables->chart_table.resize(config.plots_count + 1);
+        create_chart_table(config.plots_count, tables->chart_table.data(), config.sample_rate, config.buffer_size,
+                           config.chart_guide);
+        tables->chart_built = true;
+    }
+    if (savgolChange) {
+        uint windowSize = get_pipeline_savgol_window_size(config);
+        if (all || windowSize != get_pipeline_savgol_window_size(old)
+            || config.savgol_poly_order != old.savgol_poly_order) {
+            if (windowSize)
+                tables->savgol_coeffs = get_savgol_coeffs(windowSize, config.savgol_poly_order);
+            tables->savgol_window_size = windowSize;
+            tables->savgol_built = true;
+        }
+    }
+}
+
+// Keeps the latest samples when the ring changes size
+static vector<short> get_resized_samples(const recidia_pipeline *pipeline, uint buffer_size) {
+    vector<short> samples(buffer_size, 0);
+    size_t oldSize = pipeline->samples.size();
+    size_t keep = min(oldSize, (size_t) buffer_size);
+
+    for (size_t i=0; i < keep; i++) {
+        samples[buffer_size - keep + i] = pipeline->samples[(pipeline->samples_pos + oldSize - keep + i) % oldSize];
+    }
+    return samples;
+}
+
+// Allocates what depends on the pipeline's state first, nothing changes if that fails
+static void install_tables(recidia_pipeline *pipeline, recidia_pipeline_tables *tables) {
+    const recidia_pipeline_config &config = tables->config;
+    const recidia_pipeline_config &old = pipeline->config;
+
+    bool bufferChange = config.buffer_size != old.buffer_size;
+    bool interpChange = config.plots_count != old.plots_count || config.interp != old.interp;
+
+    vector<short> samples;
+    if (bufferChange)
+        samples = get_resized_samples(pipeline, config.buffer_size);
+    vector<float> interpHistory;
+    if (interpChange)
+        interpHistory.assign(max(config.interp, 1U) * config.plots_count, 0);
+
+    if (bufferChange) {
+        pipeline->samples.swap(samples);
+        pipeline->samples_pos = 0;
+    }
+    if (interpChange)
+        pipeline->interp_history.swap(interpHistory);
+
+    if (tables->fft_built) {
+        swap(pipeline->fft_plan, tables->fft_plan);
+        swap(pipeline->fft_in, tables->fft_in);
+        swap(pipeline->fft_out, tables->fft_out);
+    }
+    if (tables->chart_built)
+        pipeline->chart_table.swap(tables->chart_table);
+    if (tables->savgol_built) {
+        swap(pipeline->savgol_window_size, tables->savgol_window_size);
+        pipeline->savgol_coeffs.swap(tables->savgol_coeffs);
+    }
+
+    pipeline->config = config;
+}
+
+recidia_pipeline *recidia_pipeline_create(const recidia_pipeline_config *config) {
+    recidia_pipeline_tables *tables = recidia_pipeline_prepare(config, NULL);
+    if (!tables)
+        return NULL;
+
+    recidia_pipeline *pipeline = new (nothrow) recidia_pipeline;
+    if (!pipeline) {
+        recidia_pipeline_tables_destroy(tables);
+        return NULL;
+    }
+    if (recidia_pipeline_install(pipeline, tables) != 0) {
+        recidia_pipeline_destroy(pipeline);
+        return NULL;
+    }
+    return pipeline;
+}
+
+int recidia_pipeline_configure(recidia_pipeline *pipeline, const recidia_pipeline_config *config) {
+    recidia_pipeline_tables *tables = recidia_pipeline_prepare(config, &pipeline->config);
+    if (!tables)
+        return -1;
+
+    return recidia_pipeline_install(pipeline, tables);
+}
+
+recidia_pipeline_tables *recidia_pipeline_prepare(const recidia_pipeline_config *config,
+                                                  const recidia_pipeline_config *base) {
+    if (!config || !is_valid_config(*config))
+        return NULL;
+
+    recidia_pipeline_tables *tables = new (nothrow) recidia_pipeline_tables;
+    if (!tables)
+        return NULL;
+
+    tables->config = *config;
+    clamp_config(tables->config);
+    if (base) {
+        tables->base = *base;
+        tables->based = true;
+    }
+    try {
+        build_tables(tables);
+    }
+    catch (const bad_alloc &) {
+        recidia_pipeline_tables_destroy(tables);
+        return NULL;
+    }
+    return tables;
+}
+
+int recidia_pipeline_install(recidia_pipeline *pipeline, recidia_pipeline_tables *tables) {
+    int result = -1;
+    if (!tables->based || memcmp(&tables->base, &pipeline->config, sizeof(tables->base)) == 0) {
+        try {
+            install_tables(pipeline, tables);
+            result = 0;
+        }
+        catch (const bad_alloc &) {}
+    }
+    // Now has the old tables
+    recidia_pipeline_tables_destroy(tables);
+    return result;
+}
+
+void recidia_pipeline_tables_destroy(recidia_pipeline_tables *tables) {
+    if (!tables)
+        return;
+
+    destroy_fft_plan(tables->fft_plan, tables->fft_in, tables->fft_out);
+    delete tables;
+}
+
+void recidia_pipeline_get_config(const recidia_pipeline *pipeline, recidia_pipeline_config *config) {
+    *config = pipeline->config;
+}
+
+void recidia_pipeline_reset(recidia_pipeline *pipeline, unsigned long long frame_index) {
+    fill(pipeline->samples.begin(), pipeline->samples.end(), 0);
+    pipeline->samples_pos = 0;
+    fill(pipeline->interp_history.begin(), pipeline->interp_history.end(), 0);
+    pipeline->frame_index = frame_index;
+}
+
+void recidia_pipeline_destroy(recidia_pipeline *pipeline) {
+    if (!pipeline)
+        return;
+
+    destroy_fft_plan(pipeline->fft_plan, pipeline->fft_in, pipeline->fft_out);
+    delete pipeline;
+}
+
+void recidia_pipeline_push(recidia_pipeline *pipeline, const short *samples, size_t count) {
+    size_t size = pipeline->samples.size();
+    if (count > size) {
+        samples += count - size;
+        count = size;
+    }
+
+    // Overwrite the oldest, at most in 2 parts around the end of the ring
+    size_t firstPart = min(count, size - pipeline->samples_pos);
+    copy(samples, samples + firstPart, pipeline->samples.begin() + pipeline->samples_pos);
+    copy(samples + firstPart, samples + count, pipeline->samples.begin());
+    pipeline->samples_pos = (pipeline->samples_pos + count) % size;
+}
+
+unsigned int recidia_pipeline_pull(recidia_pipeline *pipeline, float *plots) {
+    const recidia_pipeline_config &config = pipeline->config;
+
+    // Oldest to newest
+    auto oldest = pipeline->samples.begin() + pipeline->samples_pos;
+    double *fftIn = copy(oldest, pipeline->samples.end(), pipeline->fft_in);
+    copy(pipeline->samples.begin(), oldest, fftIn);
+
+    fftw_execute(pipeline->fft_plan);
+    normalize_fft_output(pipeline->fft_out, config.buffer_size);
+
+    apply_chart_table(pipeline->fft_out, pipeline->chart_table.data(), config.plots_count, plots);
+
+    // Savitzky Golay Filter
+    if (pipeline->savgol_window_size)
+        apply_savgol_filter(plots, config.plots_count, pipeline->savgol_coeffs, pipeline->savgol_scratch);
+
+    // History slots follow the frame index so frames don't depend on where pulling started
+    if (config.interp) {
+        uint interpIndex = pipeline->frame_index % config.interp;
+        apply_interpolation(plots, config.plots_count, pipeline->interp_history.data(), config.plots_count,
+                            config.interp, interpIndex);
+    }
+    pipeline->frame_index++;
+
+    return config.plots_count;
+}
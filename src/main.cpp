@@ -1,7 +1,10 @@
 #include <unistd.h>
 #include <string>
+#include <cstring>
+#include <algorithm>
 #include <chrono>
 #include <thread>
+#include <atomic>
 #include <vector>
 
 #include <recidia.h>
@@ -209,7 +212,280 @@ void get_audio_device(recidia_audio_data *audio_data, int GUI) {
     }
 }
 
+// Pipeline config from the live settings
+static void get_pipeline_config(recidia_pipeline_config &config, uint sample_rate) {
+    config.sample_rate = sample_rate;
+    config.buffer_size = recidia_settings.data.audio_buffer_size;
+    // The pipeline can't make zero plots
+    config.plots_count = max(__atomic_load_n(&recidia_data.requested_plots_count, __ATOMIC_RELAXED), 1u);
+    config.interp = recidia_settings.data.interp;
+    config.savgol_window_size = recidia_settings.data.savgol_filter.window_size;
+    config.savgol_poly_order = recidia_settings.data.savgol_filter.poly_order;
+    config.chart_guide = recidia_settings.data.chart_guide;
+    config.measure_fft = 1;
+}
+
+// Mean of a range of plots, rounded up in plots count
+static float get_range_power(const float *plots, uint plots_count, const float range[2]) {
+    uint plotsPowerCount = 0.5 + (plots_count * (range[1] - range[0]));
+    uint plotPowerStart = (plots_count - 1) * range[0];
+    float power = 0.0;
+    for(uint i=plotPowerStart; i < (plotsPowerCount + plotPowerStart) && i < plots_count; i++) {
+        power += min(plots[i] / recidia_settings.data.height_cap, 1.0f) / plotsPowerCount;
+    }
+    return power;
+}
+
+void get_power_stats(const float *plots, uint plots_count, recidia_power_stats &stats) {
+    stats = {};
+    if (!plots_count)
+        return;
+
+    stats.main_power = get_range_power(plots, plots_count, recidia_settings.graphics.main_shader.power_mod_range);
+    stats.back_power = get_range_power(plots, plots_count, recidia_settings.graphics.back_shader.power_mod_range);
+
+    const uint BANDS_COUNT = sizeof(stats.bands) / sizeof(stats.bands[0]);
+    for (uint i=0; i < plots_count; i++) {
+        float power = min(plots[i] / recidia_settings.data.height_cap, 1.0f);
+
+        stats.mean += power;
+        stats.peak = max(stats.peak, power);
+        stats.bands[(i * BANDS_COUNT) / plots_count] += power;
+    }
+    stats.mean /= plots_count;
+    for (uint i=0; i < BANDS_COUNT; i++) {
+        uint bandStart = (i * plots_count + BANDS_COUNT - 1) / BANDS_COUNT;
+        uint bandEnd = ((i + 1) * plots_count + BANDS_COUNT - 1) / BANDS_COUNT;
+        if (bandEnd > bandStart)
+            stats.bands[i] /= bandEnd - bandStart;
+    }
+}
+
+// True if new plots of the requested count were published since the last update
+// Plots made for another count are skipped, the last ones keep drawing until processing catches up
+// Read as a seqlock, processing rewrites frame "i" once it has published "i + PLOTS_FRAMES_COUNT - 1", so
+// copies are only kept if the sequence didn't get that far while copying
+bool update_plots_history(recidia_plots_history &history) {
+    const uint maxAttempts = 3;
+
+    for (uint attempt=0; attempt < maxAttempts; attempt++) {
+        u_int64_t sequence = __atomic_load_n(&recidia_data.plots_sequence, __ATOMIC_ACQUIRE);
+        if (sequence == history.sequence)
+            return false;
+
+        // Frames since the last update, as far back as the ring still holds
+        u_int64_t first = sequence;
+        if (!history.current.empty()) {
+            first = history.sequence + 1;
+            if (sequence + 2 > PLOTS_FRAMES_COUNT)
+                first = max(first, sequence + 2 - PLOTS_FRAMES_COUNT);
+        }
+
+        const recidia_plots_frame &frame = recidia_data.plots_frames[sequence % PLOTS_FRAMES_COUNT];
+        uint plotsCount = frame.plots_count;
+        history.rows.clear();
+        u_int64_t rowsFirst = first;
+        for (u_int64_t i=first; i <= sequence; i++) {
+            const recidia_plots_frame &rowFrame = recidia_data.plots_frames[i % PLOTS_FRAMES_COUNT];
+            // Rows of another count don't line up
+            if (rowFrame.plots_count != plotsCount) {
+                history.rows.clear();
+                rowsFirst = i + 1;
+                continue;
+            }
+            history.rows.insert(history.rows.end(), rowFrame.plots, rowFrame.plots + plotsCount);
+        }
+        recidia_power_stats powerStats = frame.power_stats;
+        u_int64_t time = frame.time;
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        u_int64_t published = __atomic_load_n(&recidia_data.plots_sequence, __ATOMIC_RELAXED);
+        if (published + 1 >= sequence + PLOTS_FRAMES_COUNT)
+            continue; // The current plots are torn, try the newer frame
+        // Older rows may be, those are dropped
+        if (published + 2 > rowsFirst + PLOTS_FRAMES_COUNT) {
+            u_int64_t tornRows = published + 2 - PLOTS_FRAMES_COUNT - rowsFirst;
+            history.rows.erase(history.rows.begin(), history.rows.begin() + (tornRows * plotsCount));
+        }
+        history.sequence = sequence;
+
+        if (plotsCount != __atomic_load_n(&recidia_data.requested_plots_count, __ATOMIC_RELAXED)
+            && !history.current.empty()) {
+            history.rows.clear();
+            return false;
+        }
+        history.next.assign(history.rows.end() - plotsCount, history.rows.end());
+
+        // Nothing to blend from after a resize
+        if (history.current.size() != plotsCount) {
+            history.current.swap(history.next);
+            history.previous = history.current;
+            history.previous_time = time;
+        }
+        else {
+            history.previous.swap(history.current);
+            history.current.swap(history.next);
+            // Unchanged plots skipped by the GUI don't stretch the blend past a poll
+            u_int64_t pollTime = recidia_settings.data.poll_rate * 1000;
+            history.previous_time = (time > history.current_time + pollTime) ? time - pollTime : history.current_time;
+        }
+        history.current_time = time;
+        history.power_stats = powerStats;
+        // Once blended in, the drawn plots only change with new ones
+        history.changing = history.previous != history.current;
+
+        return true;
+    }
+    // Processing kept overtaking the copy, the next update tries again
+    return false;
+}
+
+// [0.0]-[1.0] from the previous to the current plots
+// The previous plots are shown as they were published, reaching the current plots when the next are due
+float get_plots_blend(const recidia_plots_history &history, u_int64_t now) {
+    if (history.current_time <= history.previous_time) // Nothing to blend from
+        return 1.0;
+    if (now <= history.current_time)
+        return 0.0;
+
+    float blend = (float) (now - history.current_time) / (history.current_time - history.previous_time);
+    return min(blend, 1.0f);
+}
+
+// Plain loop over contiguous floats so it vectorizes
+void blend_plots(const recidia_plots_history &history, float blend, float *plots) {
+    const float *previous = history.previous.data();
+    const float *current = history.current.data();
+    size_t plotsCount = history.current.size();
+
+    for (size_t i=0; i < plotsCount; i++) {
+        plots[i] = previous[i] + ((current[i] - previous[i]) * blend);
+    }
+}
+
+// Rebuilding the pipeline's tables can take a while, FFTW measures when planning
+// They are built on a helper thread while processing keeps pulling with the old ones
+// Bursts of changes, like dragging the window edge or a slider, are coalesced into one build of the latest config
+const u_int64_t TABLES_SETTLE_TIME = 50000; // us without changes before building
+const u_int64_t TABLES_MAX_DELAY = 250000; // us, builds anyway during long bursts
+
+struct TablesBuilder {
+    recidia_pipeline_config wanted; // Latest config from the settings
+    bool pending = false; // "wanted" isn't built yet
+    u_int64_t first_change = 0, last_change = 0;
+
+    thread worker;
+    atomic<bool> built{false};
+    recidia_pipeline_tables *tables = NULL; // NULL if the config was invalid
+};
+
+// Between frames, only ever swaps in finished tables
+static void update_pipeline_tables(recidia_pipeline *pipeline, TablesBuilder &builder,
+                                   const recidia_pipeline_config &config, u_int64_t now) {
+    if (builder.worker.joinable() && builder.built.load(memory_order_acquire)) {
+        builder.worker.join();
+        // Only this thread installs, so the pipeline's config is still their base
+        if (builder.tables)
+            recidia_pipeline_install(pipeline, builder.tables);
+        builder.tables = NULL;
+    }
+
+    if (memcmp(&config, &builder.wanted, sizeof(config)) != 0) {
+        if (!builder.pending)
+            builder.first_change = now;
+        builder.wanted = config;
+        builder.pending = true;
+        builder.last_change = now;
+    }
+
+    if (!builder.pending || builder.worker.joinable())
+        return;
+    if (now - builder.last_change < TABLES_SETTLE_TIME && now - builder.first_change < TABLES_MAX_DELAY)
+        return;
+
+    recidia_pipeline_config base;
+    recidia_pipeline_get_config(pipeline, &base);
+    builder.pending = false;
+    builder.built = false;
+    builder.worker = thread([&builder, wanted = builder.wanted, base]() {
+        builder.tables = recidia_pipeline_prepare(&wanted, &base);
+        builder.built.store(true, memory_order_release);
+    });
+}
+
+void init_processing(recidia_audio_data *audio_data) {
+    recidia_pipeline_config config = {};
+    get_pipeline_config(config, audio_data->sample_rate);
+
+    recidia_pipeline *pipeline = recidia_pipeline_create(&config);
+    if (!pipeline) {
+        fprintf(stderr, "Error: Could not create the processing pipeline\n");
+        exit(EXIT_FAILURE);
+    }
+    TablesBuilder tablesBuilder;
+    tablesBuilder.wanted = config;
+    float proArray[recidia_settings.data.AUDIO_BUFFER_SIZE.MAX/2];
+
+    while (1) {
+        auto timerStart = utime_now();
+
+        // Handling volatile vars, changes are swapped in once built
+        get_pipeline_config(config, audio_data->sample_rate);
+        update_pipeline_tables(pipeline, tablesBuilder, config, timerStart);
+
+        // Copy audio data
+        recidia_pipeline_push(pipeline, audio_data->samples, config.buffer_size);
+
+        // For latency display
+        recidia_data.start_time = utime_now();
+
+        // Made for the installed count, which is the tag of the frame
+        uint plotsCount = recidia_pipeline_pull(pipeline, proArray);
+
+        // Send out plots, into the oldest frame of the ring
+        u_int64_t sequence = recidia_data.plots_sequence + 1;
+        recidia_plots_frame &frame = recidia_data.plots_frames[sequence % PLOTS_FRAMES_COUNT];
+        // Silence repeats the same plots, those don't need a redraw
+        const recidia_plots_frame &lastFrame = recidia_data.plots_frames[(sequence - 1) % PLOTS_FRAMES_COUNT];
+        bool changed = lastFrame.plots_count != plotsCount || !equal(proArray, proArray + plotsCount, lastFrame.plots);
+        // The last publish is seen before any write to this frame, so a reader still copying it
+        // finds the sequence moved past it, see update_plots_history()
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        copy(proArray, proArray + plotsCount, frame.plots);
+        frame.plots_count = plotsCount;
+        get_power_stats(proArray, plotsCount, frame.power_stats);
+        frame.time = utime_now();
+        __atomic_store_n(&recidia_data.plots_sequence, sequence, __ATOMIC_RELEASE);
+        if (changed)
+            __atomic_store_n(&recidia_data.plots_changed_sequence, sequence, __ATOMIC_RELEASE);
+
+
+        // Sleep for poll time
+        uint latency = utime_now() - timerStart;
+        int sleepTime = ((recidia_settings.data.poll_rate * 1000) - latency);
+        if (sleepTime > 0)
+            usleep(sleepTime);
+    }
+}
+
 int main(int argc, char **argv) {
+    // Offline analysis of files, no audio server or UI
+    if (argc > 1 && (strcmp(argv[1], "--analyze") == 0 || strcmp(argv[1], "--batch") == 0)) {
+        recidia_settings = {};
+        init_recidia_settings(0);
+        get_config_settings(0);
+
+        return init_offline(argc-1, argv+1);
+    }
+    // Offscreen rendering of analyzed files, looks like the GUI
+    if (argc > 1 && strcmp(argv[1], "--render") == 0) {
+        recidia_settings = {};
+        init_recidia_settings(1);
+        get_config_settings(1);
+
+        return init_offscreen(argc-1, argv+1);
+    }
+
     // GUI if any arg, else it's terminal
     int GUI = argc-1;
 
@@ -237,8 +513,9 @@ int main(int argc, char **argv) {
     recidia_data.height = 10;
     recidia_data.start_time = 0;
     recidia_data.frame_time = 0;
-    recidia_data.plots_count = (recidia_data.width / (recidia_settings.design.plot_width + recidia_settings.design.gap_width));
-    recidia_data.plots = (float*) calloc(recidia_settings.data.AUDIO_BUFFER_SIZE.MAX / 2, sizeof(float));
+    recidia_data.requested_plots_count = (recidia_data.width / (recidia_settings.design.plot_width + recidia_settings.design.gap_width)) + 1;
+    for (recidia_plots_frame &frame : recidia_data.plots_frames)
+        frame.plots = (float*) calloc(recidia_settings.data.AUDIO_BUFFER_SIZE.MAX / 2, sizeof(float));
 
     // Init processing
     thread proThread(init_processing, &audioData);
@@ -246,6 +523,9 @@ int main(int argc, char **argv) {
     if (GUI) {
         init_gui(argc, argv);
     }
+    else if (recidia_settings.misc.raw_terminal) {
+        init_raw_terminal();
+    }
     else {
         init_curses();
     }
@@ -0,0 +1,541 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <recidia.h>
+
+using namespace std;
+
+static_assert(sizeof(recidia_spectrum_header) == 128, "Spectrum header must stay 128 bytes");
+
+struct offline_options {
+    uint plots_count;
+    uint hop_size; // 0 for "Poll Rate" worth
+    uint threads_count;
+};
+
+// Everything that depends on the input file
+struct offline_params {
+    uint hop_size;
+    recidia_pipeline_config config;
+};
+
+// Per thread state, the vectors are scratch reused from file to file
+struct offline_worker {
+    recidia_pipeline *pipeline = NULL;
+    offline_params params;
+    vector<char> file_data;
+    vector<short> samples;
+    vector<float> warm_up_plots;
+};
+
+// A work stealing queue of input indexes for each batch worker
+struct batch_queue {
+    mutex lock;
+    deque<uint> tasks;
+};
+
+static void read_u16(const char *data, uint16_t &value) {
+    memcpy(&value, data, sizeof(value));
+}
+
+static void read_u32(const char *data, uint32_t &value) {
+    memcpy(&value, data, sizeof(value));
+}
+
+// Reads a 16 bit PCM or 32 bit float WAV file as mono samples
+static bool read_wav(const char *path, vector<char> &data, vector<short> &samples, uint &sample_rate) {
+    ifstream file(path, ios::binary | ios::ate);
+    if (!file.is_open()) {
+        fprintf(stderr, "Error: Could not open \"%s\"\n", path);
+        return false;
+    }
+    data.resize(file.tellg());
+    file.seekg(0);
+    file.read(data.data(), data.size());
+    file.close();
+
+    if (data.size() < 12 || memcmp(data.data(), "RIFF", 4) || memcmp(data.data() + 8, "WAVE", 4)) {
+        fprintf(stderr, "Error: \"%s\" is not a WAV file\n", path);
+        return false;
+    }
+
+    uint16_t format = 0, channels = 0, bits = 0;
+    uint32_t rate = 0;
+    const char *pcm = NULL;
+    uint32_t pcmSize = 0;
+
+    size_t pos = 12;
+    while (pos + 8 <= data.size()) {
+        uint32_t chunkSize;
+        read_u32(data.data() + pos + 4, chunkSize);
+        const char *chunk = data.data() + pos + 8;
+        size_t chunkEnd = min(data.size(), pos + 8 + chunkSize);
+
+        if (!memcmp(data.data() + pos, "fmt ", 4) && chunkSize >= 16) {
+            read_u16(chunk, format);
+            read_u16(chunk + 2, channels);
+            read_u32(chunk + 4, rate);
+            read_u16(chunk + 14, bits);
+            // WAVE_FORMAT_EXTENSIBLE keeps the real format in the sub format GUID
+            if (format == 0xFFFE && chunkSize >= 26)
+                read_u16(chunk + 24, format);
+        }
+        else if (!memcmp(data.data() + pos, "data", 4)) {
+            pcm = chunk;
+            pcmSize = chunkEnd - (pos + 8);
+        }
+        pos += 8 + chunkSize + (chunkSize % 2); // Chunks are word aligned
+    }
+
+    if (!pcm || !channels || !rate) {
+        fprintf(stderr, "Error: \"%s\" is missing WAV format or data\n", path);
+        return false;
+    }
+    if (!((format == 1 && bits == 16) || (format == 3 && bits == 32))) {
+        fprintf(stderr, "Error: \"%s\" must be 16 bit PCM or 32 bit float\n", path);
+        return false;
+    }
+
+    uint frameBytes = channels * (bits / 8);
+    size_t framesCount = pcmSize / frameBytes;
+    samples.resize(framesCount);
+
+    for (size_t i=0; i < framesCount; i++) {
+        const char *frame = pcm + (i * frameBytes);
+        float sum = 0;
+
+        for (uint c=0; c < channels; c++) {
+            if (format == 1) {
+                int16_t sample;
+                memcpy(&sample, frame + (c * 2), sizeof(sample));
+                sum += sample;
+            }
+            else {
+                float sample;
+                memcpy(&sample, frame + (c * 4), sizeof(sample));
+                sum += sample * 32767;
+            }
+        }
+        // Avg. of all channels
+        float sample = sum / channels;
+        limit_setting(sample, -32768.0, 32767.0);
+        samples[i] = sample;
+    }
+    sample_rate = rate;
+
+    return true;
+}
+
+static void set_offline_params(offline_params &params, uint sample_rate, const offline_options &options) {
+    recidia_pipeline_config &config = params.config;
+    config.sample_rate = sample_rate;
+    config.buffer_size = recidia_settings.data.audio_buffer_size;
+    config.plots_count = options.plots_count;
+    config.interp = recidia_settings.data.interp;
+    config.savgol_window_size = recidia_settings.data.savgol_filter.window_size;
+    config.savgol_poly_order = recidia_settings.data.savgol_filter.poly_order;
+    config.chart_guide = recidia_settings.data.chart_guide;
+    config.measure_fft = 1;
+
+    params.hop_size = options.hop_size ? options.hop_size : (sample_rate * recidia_settings.data.poll_rate) / 1000;
+    limit_setting(params.hop_size, 1, config.buffer_size);
+}
+
+// Creates or reconfigures the worker's pipeline, "params" gets the clamped config
+static bool configure_offline_worker(offline_worker &worker, offline_params &params) {
+    if (!worker.pipeline)
+        worker.pipeline = recidia_pipeline_create(&params.config);
+    else if (recidia_pipeline_configure(worker.pipeline, &params.config) != 0)
+        return false;
+
+    if (!worker.pipeline) {
+        fprintf(stderr, "Error: Could not create the processing pipeline\n");
+        return false;
+    }
+    recidia_pipeline_get_config(worker.pipeline, &params.config);
+
+    return true;
+}
+
+static void free_offline_worker(offline_worker &worker) {
+    recidia_pipeline_destroy(worker.pipeline);
+    worker.pipeline = NULL;
+}
+
+// Creates and maps the output file, returns the frames or NULL
+static float *create_spectrum_file(const char *path, const offline_params &params, u_int64_t frames_count,
+                                   size_t &file_size) {
+    const recidia_pipeline_config &config = params.config;
+    file_size = sizeof(recidia_spectrum_header) + (frames_count * config.plots_count * sizeof(float));
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, file_size) != 0) {
+        fprintf(stderr, "Error: Could not create \"%s\"\n", path);
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+    char *output = (char*) mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // Mapping stays valid
+    if (output == MAP_FAILED) {
+        fprintf(stderr, "Error: Could not map \"%s\"\n", path);
+        return NULL;
+    }
+
+    recidia_spectrum_header header = {};
+    memcpy(header.magic, RECIDIA_SPECTRUM_MAGIC, sizeof(RECIDIA_SPECTRUM_MAGIC));
+    header.version = RECIDIA_SPECTRUM_VERSION;
+    header.header_size = sizeof(recidia_spectrum_header);
+    header.sample_rate = config.sample_rate;
+    header.hop_size = params.hop_size;
+    header.buffer_size = config.buffer_size;
+    header.plots_count = config.plots_count;
+    header.frames_count = frames_count;
+    header.height_cap = recidia_settings.data.height_cap;
+    header.interp = config.interp;
+    header.savgol_window_size = config.savgol_window_size;
+    header.savgol_poly_order = config.savgol_poly_order;
+    header.chart_guide[0] = config.chart_guide.start_freq;
+    header.chart_guide[1] = config.chart_guide.start_ctrl;
+    header.chart_guide[2] = config.chart_guide.mid_freq;
+    header.chart_guide[3] = config.chart_guide.mid_pos;
+    header.chart_guide[4] = config.chart_guide.end_ctrl;
+    header.chart_guide[5] = config.chart_guide.end_freq;
+    memcpy(output, &header, sizeof(header));
+
+    return (float*) (output + sizeof(recidia_spectrum_header));
+}
+
+static void close_spectrum_file(float *frames, size_t file_size) {
+    munmap((char*) frames - sizeof(recidia_spectrum_header), file_size);
+}
+
+// Frame "i" is the audio buffer that ends at sample (i+1) * hop_size, silence before the start
+static void analyze_frames(offline_worker &worker, const offline_params &params,
+                           const vector<short> &samples, u_int64_t first_frame, u_int64_t last_frame, float *frames) {
+    uint plotsCount = params.config.plots_count;
+    uint interp = params.config.interp;
+    worker.warm_up_plots.resize(plotsCount);
+
+    // Warm up the interpolation with the frames before this range,
+    // frames are pulled at their own index so any split gives the same output
+    u_int64_t warmUp = interp ? interp - 1 : 0;
+    u_int64_t startFrame = (first_frame > warmUp) ? first_frame - warmUp : 0;
+    recidia_pipeline_reset(worker.pipeline, startFrame);
+
+    u_int64_t startSample = startFrame * params.hop_size;
+    u_int64_t historySize = min(startSample, (u_int64_t) params.config.buffer_size);
+    recidia_pipeline_push(worker.pipeline, samples.data() + startSample - historySize, historySize);
+
+    for (u_int64_t f=startFrame; f < last_frame; f++) {
+        recidia_pipeline_push(worker.pipeline, samples.data() + (f * params.hop_size), params.hop_size);
+
+        float *plots = (f >= first_frame) ? frames + (f * plotsCount) : worker.warm_up_plots.data();
+        recidia_pipeline_pull(worker.pipeline, plots);
+    }
+}
+
+// Single threaded analysis of a whole file, returns frames written or -1
+static int64_t analyze_file(offline_worker &worker, const offline_options &options, const char *input_path,
+                            const char *output_path) {
+    uint sampleRate;
+    if (!read_wav(input_path, worker.file_data, worker.samples, sampleRate))
+        return -1;
+    set_offline_params(worker.params, sampleRate, options);
+    if (!configure_offline_worker(worker, worker.params))
+        return -1;
+
+    u_int64_t framesCount = worker.samples.size() / worker.params.hop_size;
+    if (!framesCount) {
+        fprintf(stderr, "Error: \"%s\" is shorter than one hop\n", input_path);
+        return -1;
+    }
+
+    size_t fileSize;
+    float *frames = create_spectrum_file(output_path, worker.params, framesCount, fileSize);
+    if (!frames)
+        return -1;
+
+    analyze_frames(worker, worker.params, worker.samples, 0, framesCount, frames);
+    close_spectrum_file(frames, fileSize);
+
+    return framesCount;
+}
+
+static bool steal_task(vector<batch_queue> &queues, uint worker_index, uint &task) {
+    // Own queue from the front (biggest files first), others from the back
+    for (uint i=0; i < queues.size(); i++) {
+        batch_queue &queue = queues[(worker_index + i) % queues.size()];
+        lock_guard<mutex> guard(queue.lock);
+
+        if (queue.tasks.empty())
+            continue;
+
+        if (i == 0) {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+        else {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+        return true;
+    }
+    return false;
+}
+
+static void batch_worker(offline_worker &worker, uint worker_index, vector<batch_queue> &queues,
+                         const offline_options &options, const vector<string> &inputs, const vector<string> &outputs,
+                         vector<int64_t> &frames_counts) {
+    uint task;
+    while (steal_task(queues, worker_index, task)) {
+        frames_counts[task] = analyze_file(worker, options, inputs[task].c_str(), outputs[task].c_str());
+    }
+}
+
+static bool is_wav_path(const filesystem::path &path) {
+    string extension = path.extension();
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    return extension == ".wav";
+}
+
+// Inputs are files or directories searched for .wav files, outputs mirror them as .rsf
+// False if two inputs would be written to the same output
+static bool get_batch_files(char **paths, int paths_count, const filesystem::path &output_dir,
+                            vector<string> &inputs, vector<string> &outputs) {
+    for (int i=0; i < paths_count; i++) {
+        filesystem::path path = paths[i];
+
+        if (filesystem::is_directory(path)) {
+            for (const auto &entry : filesystem::recursive_directory_iterator(path)) {
+                if (!entry.is_regular_file() || !is_wav_path(entry.path()))
+                    continue;
+
+                filesystem::path output = output_dir / filesystem::relative(entry.path(), path);
+                output.replace_extension(".rsf");
+
+                inputs.push_back(entry.path());
+                outputs.push_back(output.lexically_normal());
+            }
+        }
+        else {
+            filesystem::path output = output_dir / path.filename();
+            output.replace_extension(".rsf");
+
+            inputs.push_back(path);
+            outputs.push_back(output.lexically_normal());
+        }
+    }
+
+    // Inputs with the same name in different dirs, or "x.wav" next to "x.WAV", would write the same file
+    map<string, uint> outputInputs;
+    for (uint i=0; i < outputs.size(); i++) {
+        auto inserted = outputInputs.insert({outputs[i], i});
+        if (!inserted.second) {
+            fprintf(stderr, "Error: \"%s\" and \"%s\" would both be written to \"%s\"\n",
+                    inputs[inserted.first->second].c_str(), inputs[i].c_str(), outputs[i].c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+static int init_batch(const offline_options &options, char **paths, int paths_count) {
+    filesystem::path outputDir = paths[0];
+    vector<string> inputs, outputs;
+    try {
+        if (!get_batch_files(paths+1, paths_count-1, outputDir, inputs, outputs))
+            return EXIT_FAILURE;
+        for (uint i=0; i < outputs.size(); i++) {
+            filesystem::create_directories(filesystem::path(outputs[i]).parent_path());
+        }
+    }
+    catch (filesystem::filesystem_error const& ex) {
+        fprintf(stderr, "Error: %s\n", ex.what());
+        return EXIT_FAILURE;
+    }
+    if (inputs.empty()) {
+        fprintf(stderr, "Error: No WAV files found\n");
+        return EXIT_FAILURE;
+    }
+
+    uint threadsCount = min((size_t) options.threads_count, inputs.size());
+
+    // Deal the biggest files out first so stealing only has to even out the tail
+    vector<uint> order(inputs.size());
+    vector<uintmax_t> sizes(inputs.size());
+    for (uint i=0; i < inputs.size(); i++) {
+        order[i] = i;
+        struct stat fileStat;
+        sizes[i] = (stat(inputs[i].c_str(), &fileStat) == 0) ? fileStat.st_size : 0;
+    }
+    sort(order.begin(), order.end(), [&](uint a, uint b) { return sizes[a] > sizes[b]; });
+
+    vector<batch_queue> queues(threadsCount);
+    for (uint i=0; i < order.size(); i++) {
+        queues[i % threadsCount].tasks.push_back(order[i]);
+    }
+
+    // Pipelines are made by the workers, per file
+    vector<offline_worker> workers(threadsCount);
+
+    auto timerStart = utime_now();
+
+    vector<int64_t> framesCounts(inputs.size());
+    vector<thread> threads;
+    for (uint t=0; t < threadsCount; t++) {
+        threads.emplace_back(batch_worker, ref(workers[t]), t, ref(queues), cref(options),
+                             cref(inputs), cref(outputs), ref(framesCounts));
+    }
+    for (uint t=0; t < threadsCount; t++) {
+        threads[t].join();
+        free_offline_worker(workers[t]);
+    }
+
+    double seconds = (double) (utime_now() - timerStart) / 1000000;
+    u_int64_t totalFrames = 0;
+    uint failed = 0;
+    for (uint i=0; i < framesCounts.size(); i++) {
+        if (framesCounts[i] < 0)
+            failed++;
+        else
+            totalFrames += framesCounts[i];
+    }
+    fprintf(stderr, "%zu files (%u failed), %llu frames in %.3fs (%.0f frames/s, %u threads)\n",
+            inputs.size(), failed, (unsigned long long) totalFrames, seconds, totalFrames / seconds, threadsCount);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int init_analyze(const offline_options &options, const char *input_path, const char *output_path) {
+    offline_worker mainWorker;
+    offline_params &params = mainWorker.params;
+
+    uint sampleRate;
+    if (!read_wav(input_path, mainWorker.file_data, mainWorker.samples, sampleRate))
+        return EXIT_FAILURE;
+    set_offline_params(params, sampleRate, options);
+
+    u_int64_t framesCount = mainWorker.samples.size() / params.hop_size;
+    if (!framesCount) {
+        fprintf(stderr, "Error: \"%s\" is shorter than one hop\n", input_path);
+        return EXIT_FAILURE;
+    }
+
+    // Split frames across cores, each range warms up its own interpolation
+    uint threadsCount = min((u_int64_t) options.threads_count, framesCount);
+
+    vector<offline_worker> workers(threadsCount);
+    for (uint t=0; t < threadsCount; t++) {
+        if (!configure_offline_worker(workers[t], params)) {
+            for (uint i=0; i < t; i++) {
+                free_offline_worker(workers[i]);
+            }
+            return EXIT_FAILURE;
+        }
+    }
+
+    size_t fileSize;
+    float *frames = create_spectrum_file(output_path, params, framesCount, fileSize);
+    if (!frames) {
+        for (uint t=0; t < threadsCount; t++) {
+            free_offline_worker(workers[t]);
+        }
+        return EXIT_FAILURE;
+    }
+
+    auto timerStart = utime_now();
+
+    vector<thread> threads;
+    u_int64_t chunkSize = (framesCount + threadsCount - 1) / threadsCount;
+    for (uint t=0; t < threadsCount; t++) {
+        u_int64_t firstFrame = t * chunkSize;
+        u_int64_t lastFrame = min(firstFrame + chunkSize, framesCount);
+
+        threads.emplace_back(analyze_frames, ref(workers[t]), cref(params), cref(mainWorker.samples),
+                             firstFrame, lastFrame, frames);
+    }
+    for (uint t=0; t < threadsCount; t++) {
+        threads[t].join();
+        free_offline_worker(workers[t]);
+    }
+
+    double seconds = (double) (utime_now() - timerStart) / 1000000;
+    fprintf(stderr, "%llu frames of %u plots in %.3fs (%.0f frames/s, %u threads)\n",
+            (unsigned long long) framesCount, params.config.plots_count, seconds, framesCount / seconds, threadsCount);
+
+    close_spectrum_file(frames, fileSize);
+
+    return EXIT_SUCCESS;
+}
+
+static void print_offline_usage() {
+    fprintf(stderr, "Usage: recidia --analyze [options] <input.wav> <output.rsf>\n"
+                    "       recidia --batch [options] <output dir> <input dir or .wav>...\n"
+                    "  -p, --plots <count>    Plots per frame (default 128)\n"
+                    "  -H, --hop <samples>    Samples between frames (default \"Poll Rate\" worth)\n"
+                    "  -j, --threads <count>  Worker threads (default all cores)\n");
+}
+
+// argv[0] is the mode, "--analyze" or "--batch"
+int init_offline(int argc, char **argv) {
+    bool batch = strcmp(argv[0], "--batch") == 0;
+
+    offline_options options;
+    options.plots_count = 128;
+    options.hop_size = 0;
+    options.threads_count = thread::hardware_concurrency();
+
+    static const struct option longOptions[] = {
+        {"plots", required_argument, NULL, 'p'},
+        {"hop", required_argument, NULL, 'H'},
+        {"threads", required_argument, NULL, 'j'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "p:H:j:h", longOptions, NULL)) != -1) {
+        switch (opt) {
+            case 'p':
+                options.plots_count = atoi(optarg);
+                break;
+            case 'H':
+                options.hop_size = atoi(optarg);
+                break;
+            case 'j':
+                options.threads_count = atoi(optarg);
+                break;
+            default:
+                print_offline_usage();
+                return EXIT_FAILURE;
+        }
+    }
+    if ((!batch && argc - optind != 2) || (batch && argc - optind < 2)) {
+        print_offline_usage();
+        return EXIT_FAILURE;
+    }
+
+    limit_setting(options.plots_count, 1, recidia_settings.data.audio_buffer_size / 2 - 1);
+    if (options.threads_count < 1)
+        options.threads_count = 1;
+
+    if (batch)
+        return init_batch(options, argv + optind, argc - optind);
+    else
+        return init_analyze(options, argv[optind], argv[optind+1]);
+}
@@ -0,0 +1,809 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+#include <vulkan/vulkan.h>
+
+#include <render.hpp>
+#include <recidia.h>
+
+using namespace std;
+
+enum offscreen_format {
+    FORMAT_Y4M,
+    FORMAT_RGBA,
+    FORMAT_PNG
+};
+
+struct offscreen_options {
+    uint width;
+    uint height;
+    uint fps;
+    offscreen_format format;
+};
+
+// One frame is written out while the next renders
+const uint OFFSCREEN_FRAMES = 2;
+static_assert(OFFSCREEN_FRAMES <= RENDER_MAX_FRAMES, "See FrameResources");
+
+// The shaders output linear colors, the bytes read back are sRGB
+const VkFormat OFFSCREEN_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+
+struct offscreen_frame {
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory image_memory = VK_NULL_HANDLE;
+    VkImageView image_view = VK_NULL_HANDLE;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+    VkBuffer staging = VK_NULL_HANDLE;
+    VkDeviceMemory staging_memory = VK_NULL_HANDLE;
+    const unsigned char *pixels; // Persistently mapped, RGBA rows
+
+    VkCommandBuffer command_buffer;
+    VkFence fence = VK_NULL_HANDLE;
+    bool rendering = false; // Submitted and not written out yet
+};
+
+struct offscreen_renderer {
+    VkInstance instance = VK_NULL_HANDLE;
+    VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties properties;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    uint32_t queue_family;
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue queue;
+
+    VkRenderPass render_pass = VK_NULL_HANDLE;
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    FrameResources frame_resources;
+    SpectrogramResources spectrogram;
+    offscreen_frame frames[OFFSCREEN_FRAMES];
+
+    VkPipelineLayout main_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline main_pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout back_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline back_pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout spectrogram_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline spectrogram_pipeline = VK_NULL_HANDLE;
+};
+
+struct offscreen_output {
+    offscreen_format format;
+    FILE *file = NULL; // Y4M and RGBA streams
+    filesystem::path dir; // PNG frames
+    // Scratch reused from frame to frame
+    vector<unsigned char> frame_data;
+    vector<unsigned char> compressed;
+};
+
+// Maps a spectrum file from "recidia --analyze", returns the frames or NULL
+static const float *map_spectrum_file(const char *path, recidia_spectrum_header &header, size_t &file_size) {
+    int fd = open(path, O_RDONLY);
+    struct stat fileStat;
+    if (fd < 0 || fstat(fd, &fileStat) != 0) {
+        fprintf(stderr, "Error: Could not open \"%s\"\n", path);
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+    file_size = fileStat.st_size;
+
+    if (file_size < sizeof(recidia_spectrum_header)) {
+        fprintf(stderr, "Error: \"%s\" is not a spectrum file\n", path);
+        close(fd);
+        return NULL;
+    }
+    char *data = (char*) mmap(NULL, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // Mapping stays valid
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Error: Could not map \"%s\"\n", path);
+        return NULL;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.magic, RECIDIA_SPECTRUM_MAGIC, sizeof(RECIDIA_SPECTRUM_MAGIC))
+        || header.version != RECIDIA_SPECTRUM_VERSION) {
+        fprintf(stderr, "Error: \"%s\" is not a version %d spectrum file\n", path, RECIDIA_SPECTRUM_VERSION);
+        munmap(data, file_size);
+        return NULL;
+    }
+    if (!header.plots_count || !header.frames_count || !header.hop_size || !header.sample_rate
+        || header.header_size + (header.frames_count * header.plots_count * sizeof(float)) > file_size) {
+        fprintf(stderr, "Error: \"%s\" is empty or truncated\n", path);
+        munmap(data, file_size);
+        return NULL;
+    }
+
+    return (const float*) (data + header.header_size);
+}
+
+// No surface or swap chain, any device with a graphics queue will do (lavapipe included)
+static void create_device(offscreen_renderer &renderer) {
+    VkApplicationInfo appInfo{};
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pApplicationName = "recidia";
+    appInfo.apiVersion = VK_API_VERSION_1_0;
+
+    VkInstanceCreateInfo instanceInfo{};
+    instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instanceInfo.pApplicationInfo = &appInfo;
+    if (vkCreateInstance(&instanceInfo, nullptr, &renderer.instance) != VK_SUCCESS) {
+        renderer.instance = VK_NULL_HANDLE;
+        throw std::runtime_error("Failed to create Vulkan instance!");
+    }
+
+    uint32_t devicesCount = 0;
+    vkEnumeratePhysicalDevices(renderer.instance, &devicesCount, nullptr);
+    vector<VkPhysicalDevice> devices(devicesCount);
+    vkEnumeratePhysicalDevices(renderer.instance, &devicesCount, devices.data());
+
+    for (uint i=0; i < devicesCount && !renderer.physical_device; i++) {
+        uint32_t familiesCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(devices[i], &familiesCount, nullptr);
+        vector<VkQueueFamilyProperties> families(familiesCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(devices[i], &familiesCount, families.data());
+
+        for (uint32_t j=0; j < familiesCount; j++) {
+            if (families[j].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+                renderer.physical_device = devices[i];
+                renderer.queue_family = j;
+                break;
+            }
+        }
+    }
+    if (!renderer.physical_device)
+        throw std::runtime_error("No Vulkan device with a graphics queue!");
+
+    vkGetPhysicalDeviceProperties(renderer.physical_device, &renderer.properties);
+    vkGetPhysicalDeviceMemoryProperties(renderer.physical_device, &renderer.memory_properties);
+
+    float queuePriority = 1.0;
+    VkDeviceQueueCreateInfo queueInfo{};
+    queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueInfo.queueFamilyIndex = renderer.queue_family;
+    queueInfo.queueCount = 1;
+    queueInfo.pQueuePriorities = &queuePriority;
+
+    VkDeviceCreateInfo deviceInfo{};
+    deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceInfo.queueCreateInfoCount = 1;
+    deviceInfo.pQueueCreateInfos = &queueInfo;
+    if (vkCreateDevice(renderer.physical_device, &deviceInfo, nullptr, &renderer.device) != VK_SUCCESS) {
+        renderer.device = VK_NULL_HANDLE;
+        throw std::runtime_error("Failed to create Vulkan device!");
+    }
+    if (!init_render_device(renderer.device, vkGetDeviceProcAddr)) {
+        vkDestroyDevice(renderer.device, nullptr);
+        renderer.device = VK_NULL_HANDLE;
+        throw std::runtime_error("Failed to load the device functions!");
+    }
+
+    dev_funct->vkGetDeviceQueue(vulkan_dev, renderer.queue_family, 0, &renderer.queue);
+    fprintf(stderr, "Rendering with %s\n", renderer.properties.deviceName);
+}
+
+// Left ready to copy out of once the plots are drawn
+static void create_render_pass(offscreen_renderer &renderer) {
+    VkAttachmentDescription colorAtt{};
+    colorAtt.format = OFFSCREEN_FORMAT;
+    colorAtt.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAtt.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAtt.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAtt.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAtt.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAtt.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAtt.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+    VkAttachmentReference colorRef{};
+    colorRef.attachment = 0;
+    colorRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorRef;
+
+    // After the last copy out of the image, before the copy out of this frame
+    VkSubpassDependency dependencies[2]{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].srcAccessMask = 0;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &colorAtt;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 2;
+    renderPassInfo.pDependencies = dependencies;
+
+    if (dev_funct->vkCreateRenderPass(vulkan_dev, &renderPassInfo, nullptr, &renderer.render_pass) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create render pass!");
+}
+
+// An image to draw into and a buffer to read it back from per frame in flight
+static void create_frames(offscreen_renderer &renderer, uint width, uint height) {
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = renderer.queue_family;
+    if (dev_funct->vkCreateCommandPool(vulkan_dev, &poolInfo, nullptr, &renderer.command_pool) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create command pool!");
+
+    // Cached for reading back, the plots are only written
+    uint32_t stagingMemoryIndex;
+    const VkMemoryPropertyFlags hostFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    if (!find_memory_type(renderer.memory_properties, ~0U, hostFlags | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                          stagingMemoryIndex)
+        && !find_memory_type(renderer.memory_properties, ~0U, hostFlags, stagingMemoryIndex))
+        throw std::runtime_error("No host visible memory!");
+
+    VkDeviceSize frameSize = (VkDeviceSize) width * height * 4;
+
+    for (uint i=0; i < OFFSCREEN_FRAMES; i++) {
+        offscreen_frame &frame = renderer.frames[i];
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = OFFSCREEN_FORMAT;
+        imageInfo.extent = {width, height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        if (dev_funct->vkCreateImage(vulkan_dev, &imageInfo, nullptr, &frame.image) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create image!");
+
+        VkMemoryRequirements memRequirements;
+        dev_funct->vkGetImageMemoryRequirements(vulkan_dev, frame.image, &memRequirements);
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        if (!find_memory_type(renderer.memory_properties, memRequirements.memoryTypeBits,
+                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, allocInfo.memoryTypeIndex)
+            && !find_memory_type(renderer.memory_properties, memRequirements.memoryTypeBits, 0,
+                                 allocInfo.memoryTypeIndex))
+            throw std::runtime_error("No memory for the image!");
+
+        if (dev_funct->vkAllocateMemory(vulkan_dev, &allocInfo, nullptr, &frame.image_memory) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate image memory!");
+        dev_funct->vkBindImageMemory(vulkan_dev, frame.image, frame.image_memory, 0);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = frame.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = OFFSCREEN_FORMAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.layerCount = 1;
+        if (dev_funct->vkCreateImageView(vulkan_dev, &viewInfo, nullptr, &frame.image_view) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create image view!");
+
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderer.render_pass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &frame.image_view;
+        framebufferInfo.width = width;
+        framebufferInfo.height = height;
+        framebufferInfo.layers = 1;
+        if (dev_funct->vkCreateFramebuffer(vulkan_dev, &framebufferInfo, nullptr, &frame.framebuffer) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create framebuffer!");
+
+        createBuffer(frameSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, stagingMemoryIndex, frame.staging,
+                     frame.staging_memory);
+        void *pixels;
+        if (dev_funct->vkMapMemory(vulkan_dev, frame.staging_memory, 0, VK_WHOLE_SIZE, 0, &pixels) != VK_SUCCESS)
+            throw std::runtime_error("Failed to map memory!");
+        frame.pixels = (const unsigned char*) pixels;
+
+        VkCommandBufferAllocateInfo commandBufferInfo{};
+        commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferInfo.commandPool = renderer.command_pool;
+        commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferInfo.commandBufferCount = 1;
+        if (dev_funct->vkAllocateCommandBuffers(vulkan_dev, &commandBufferInfo, &frame.command_buffer) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate command buffer!");
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (dev_funct->vkCreateFence(vulkan_dev, &fenceInfo, nullptr, &frame.fence) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create fence!");
+    }
+}
+
+// Works on a partly created renderer too
+static void release_renderer(offscreen_renderer &renderer) {
+    if (renderer.device) {
+        dev_funct->vkDeviceWaitIdle(vulkan_dev);
+
+        for (offscreen_frame &frame : renderer.frames) {
+            if (frame.fence)
+                dev_funct->vkDestroyFence(vulkan_dev, frame.fence, nullptr);
+            if (frame.staging)
+                dev_funct->vkDestroyBuffer(vulkan_dev, frame.staging, nullptr);
+            if (frame.staging_memory) {
+                dev_funct->vkUnmapMemory(vulkan_dev, frame.staging_memory);
+                dev_funct->vkFreeMemory(vulkan_dev, frame.staging_memory, nullptr);
+            }
+            if (frame.framebuffer)
+                dev_funct->vkDestroyFramebuffer(vulkan_dev, frame.framebuffer, nullptr);
+            if (frame.image_view)
+                dev_funct->vkDestroyImageView(vulkan_dev, frame.image_view, nullptr);
+            if (frame.image)
+                dev_funct->vkDestroyImage(vulkan_dev, frame.image, nullptr);
+            if (frame.image_memory)
+                dev_funct->vkFreeMemory(vulkan_dev, frame.image_memory, nullptr);
+        }
+        if (renderer.command_pool)
+            dev_funct->vkDestroyCommandPool(vulkan_dev, renderer.command_pool, nullptr);
+
+        release_pipeline_cache();
+
+        VkPipeline pipelines[] = {renderer.main_pipeline, renderer.back_pipeline, renderer.spectrogram_pipeline};
+        VkPipelineLayout layouts[] = {renderer.main_pipelineLayout, renderer.back_pipelineLayout,
+                                      renderer.spectrogram_pipelineLayout};
+        for (uint i=0; i < 3; i++) {
+            if (pipelines[i])
+                dev_funct->vkDestroyPipeline(vulkan_dev, pipelines[i], nullptr);
+            if (layouts[i])
+                dev_funct->vkDestroyPipelineLayout(vulkan_dev, layouts[i], nullptr);
+        }
+
+        release_spectrogram(renderer.spectrogram);
+        release_frame_resources(renderer.frame_resources);
+
+        if (renderer.render_pass)
+            dev_funct->vkDestroyRenderPass(vulkan_dev, renderer.render_pass, nullptr);
+
+        dev_funct->vkDestroyDevice(vulkan_dev, nullptr);
+    }
+    if (renderer.instance)
+        vkDestroyInstance(renderer.instance, nullptr);
+}
+
+static void init_renderer(offscreen_renderer &renderer, const offscreen_options &options) {
+    create_device(renderer);
+
+    uint maxSize = renderer.properties.limits.maxImageDimension2D;
+    if (options.width > maxSize || options.height > maxSize)
+        throw std::runtime_error("Frame size is over the device's " + to_string(maxSize) + " pixels!");
+
+    create_render_pass(renderer);
+
+    finalize_buffers_size();
+    uint32_t plotsMemoryIndex;
+    if (!find_memory_type(renderer.memory_properties, ~0U,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, plotsMemoryIndex))
+        throw std::runtime_error("No host visible memory!");
+    create_frame_resources(renderer.frame_resources, OFFSCREEN_FRAMES, renderer.properties.limits, plotsMemoryIndex);
+    create_spectrogram(renderer.spectrogram, renderer.frame_resources, OFFSCREEN_FRAMES, renderer.properties.limits,
+                       renderer.memory_properties);
+
+    create_pipeline_cache(renderer.properties);
+    createPipline(recidia_settings.graphics.back_shader, renderer.render_pass, VK_SAMPLE_COUNT_1_BIT,
+                  renderer.frame_resources.desc_set_layout, renderer.back_pipelineLayout, renderer.back_pipeline);
+    createPipline(recidia_settings.graphics.main_shader, renderer.render_pass, VK_SAMPLE_COUNT_1_BIT,
+                  renderer.frame_resources.desc_set_layout, renderer.main_pipelineLayout, renderer.main_pipeline);
+    createPipline(get_spectrogram_shader(), renderer.render_pass, VK_SAMPLE_COUNT_1_BIT,
+                  renderer.frame_resources.desc_set_layout, renderer.spectrogram_pipelineLayout,
+                  renderer.spectrogram_pipeline);
+    if (!renderer.main_pipeline || !renderer.back_pipeline || !renderer.spectrogram_pipeline)
+        throw std::runtime_error("Failed to build the shaders!");
+
+    create_frames(renderer, options.width, options.height);
+}
+
+// Same draws as the GUI, then the image is copied into the frame's staging buffer
+// "new_rows" are the spectra since the last frame, pushed to the spectrogram
+static void render_frame(offscreen_renderer &renderer, uint slot, const offscreen_options &options,
+                         const recidia_plots_history &plots_history, const float *new_rows, uint new_rows_count,
+                         float blend, u_int64_t time, const float main_color[4], const float back_color[4]) {
+    offscreen_frame &frame = renderer.frames[slot];
+    VkCommandBuffer commandBuffer = frame.command_buffer;
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (dev_funct->vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("Failed to begin command buffer!");
+
+    VkViewport viewport;
+    viewport.x = 0;
+    viewport.y = 0;
+    viewport.width = options.width;
+    viewport.height = options.height;
+    viewport.minDepth = 0;
+    viewport.maxDepth = 1;
+    dev_funct->vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor;
+    scissor.offset = {0, 0};
+    scissor.extent = {options.width, options.height};
+    dev_funct->vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    VkClearValue clearValue{};
+    clearValue.color = {{0, 0, 0, 1}};
+
+    VkRenderPassBeginInfo rpBeginInfo{};
+    rpBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    rpBeginInfo.renderPass = renderer.render_pass;
+    rpBeginInfo.framebuffer = frame.framebuffer;
+    rpBeginInfo.renderArea.extent = scissor.extent;
+    rpBeginInfo.clearValueCount = 1;
+    rpBeginInfo.pClearValues = &clearValue;
+
+    memcpy(renderer.frame_resources.audio_slices[slot], &plots_history.power_stats, sizeof(recidia_power_stats));
+    push_spectrogram_rows(commandBuffer, renderer.spectrogram, slot, new_rows, new_rows_count,
+                          plots_history.current.size());
+
+    VkDescriptorSet &descSet = renderer.frame_resources.desc_sets[slot];
+    dev_funct->vkCmdBeginRenderPass(commandBuffer, &rpBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    draw_background(commandBuffer, renderer.back_pipelineLayout, renderer.back_pipeline, descSet, plots_history,
+                    back_color, time);
+    if (recidia_settings.design.draw_mode == DRAW_SPECTROGRAM)
+        draw_spectrogram(commandBuffer, renderer.spectrogram_pipelineLayout, renderer.spectrogram_pipeline, descSet,
+                         renderer.spectrogram, plots_history, options.width, time);
+    else
+        draw_plots(commandBuffer, renderer.main_pipelineLayout, renderer.main_pipeline, descSet,
+                   renderer.frame_resources.plots_slices[slot], plots_history, main_color, options.width,
+                   options.height, blend, time);
+    dev_funct->vkCmdEndRenderPass(commandBuffer);
+
+    // Tightly packed rows
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = {options.width, options.height, 1};
+    dev_funct->vkCmdCopyImageToBuffer(commandBuffer, frame.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frame.staging,
+                                      1, &region);
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = frame.staging;
+    barrier.size = VK_WHOLE_SIZE;
+    dev_funct->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                                    0, nullptr, 1, &barrier, 0, nullptr);
+
+    if (dev_funct->vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to record command buffer!");
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    dev_funct->vkResetFences(vulkan_dev, 1, &frame.fence);
+    if (dev_funct->vkQueueSubmit(renderer.queue, 1, &submitInfo, frame.fence) != VK_SUCCESS)
+        throw std::runtime_error("Failed to submit frame!");
+    frame.rendering = true;
+}
+
+static void write_u32_be(unsigned char *data, uint32_t value) {
+    data[0] = value >> 24;
+    data[1] = value >> 16;
+    data[2] = value >> 8;
+    data[3] = value;
+}
+
+static void write_png_chunk(FILE *file, const char *type, const unsigned char *data, uint32_t size) {
+    unsigned char length[4], crc[4];
+    write_u32_be(length, size);
+
+    uLong chunkCrc = crc32(0, (const Bytef*) type, 4);
+    chunkCrc = crc32(chunkCrc, data, size);
+    write_u32_be(crc, chunkCrc);
+
+    fwrite(length, 1, 4, file);
+    fwrite(type, 1, 4, file);
+    fwrite(data, 1, size, file);
+    fwrite(crc, 1, 4, file);
+}
+
+// 8 bit RGB, frames are opaque
+static bool write_png(const char *path, const unsigned char *pixels, uint width, uint height,
+                      offscreen_output &output) {
+    // Every row starts with its filter type, none
+    size_t rowSize = 1 + (width * 3);
+    output.frame_data.resize(rowSize * height);
+    for (uint y=0; y < height; y++) {
+        unsigned char *row = output.frame_data.data() + (y * rowSize);
+        const unsigned char *pixel = pixels + ((size_t) y * width * 4);
+        row[0] = 0;
+        for (uint x=0; x < width; x++) {
+            memcpy(row + 1 + (x * 3), pixel + (x * 4), 3);
+        }
+    }
+
+    uLongf compressedSize = compressBound(output.frame_data.size());
+    output.compressed.resize(compressedSize);
+    if (compress2(output.compressed.data(), &compressedSize, output.frame_data.data(), output.frame_data.size(),
+                  Z_BEST_SPEED) != Z_OK) {
+        fprintf(stderr, "Error: Could not compress \"%s\"\n", path);
+        return false;
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not create \"%s\"\n", path);
+        return false;
+    }
+    static const unsigned char PNG_SIGNATURE[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+    fwrite(PNG_SIGNATURE, 1, sizeof(PNG_SIGNATURE), file);
+
+    // Bit depth 8, color type 2 (RGB), default compression, filtering and no interlace
+    unsigned char header[13] = {};
+    write_u32_be(header, width);
+    write_u32_be(header + 4, height);
+    header[8] = 8;
+    header[9] = 2;
+    write_png_chunk(file, "IHDR", header, sizeof(header));
+    write_png_chunk(file, "IDAT", output.compressed.data(), compressedSize);
+    write_png_chunk(file, "IEND", NULL, 0);
+
+    bool failed = ferror(file);
+    if (fclose(file) != 0 || failed) {
+        fprintf(stderr, "Error: Could not write \"%s\"\n", path);
+        return false;
+    }
+    return true;
+}
+
+// BT.601 limited range, full resolution chroma (C444)
+static bool write_y4m_frame(const unsigned char *pixels, uint width, uint height, offscreen_output &output) {
+    size_t planeSize = (size_t) width * height;
+    output.frame_data.resize(planeSize * 3);
+    unsigned char *yPlane = output.frame_data.data();
+    unsigned char *uPlane = yPlane + planeSize;
+    unsigned char *vPlane = uPlane + planeSize;
+
+    for (size_t i=0; i < planeSize; i++) {
+        int r = pixels[i * 4];
+        int g = pixels[(i * 4) + 1];
+        int b = pixels[(i * 4) + 2];
+        yPlane[i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+        uPlane[i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+        vPlane[i] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+    }
+
+    fputs("FRAME\n", output.file);
+    return fwrite(output.frame_data.data(), 1, output.frame_data.size(), output.file) == output.frame_data.size();
+}
+
+static bool write_frame(offscreen_output &output, const offscreen_frame &frame, u_int64_t index,
+                        const offscreen_options &options) {
+    switch (output.format) {
+        case FORMAT_Y4M:
+            if (write_y4m_frame(frame.pixels, options.width, options.height, output))
+                return true;
+            break;
+
+        case FORMAT_RGBA: {
+            size_t frameSize = (size_t) options.width * options.height * 4;
+            if (fwrite(frame.pixels, 1, frameSize, output.file) == frameSize)
+                return true;
+            break;
+        }
+
+        case FORMAT_PNG: {
+            char name[32];
+            snprintf(name, sizeof(name), "%06llu.png", (unsigned long long) index);
+            return write_png((output.dir / name).c_str(), frame.pixels, options.width, options.height, output);
+        }
+    }
+    fprintf(stderr, "Error: Could not write frame %llu\n", (unsigned long long) index);
+    return false;
+}
+
+static bool open_output(offscreen_output &output, const offscreen_options &options, const char *path) {
+    output.format = options.format;
+
+    if (output.format == FORMAT_PNG) {
+        output.dir = path;
+        error_code ec;
+        filesystem::create_directories(output.dir, ec);
+        if (ec) {
+            fprintf(stderr, "Error: Could not create \"%s\": %s\n", path, ec.message().c_str());
+            return false;
+        }
+        return true;
+    }
+
+    if (strcmp(path, "-") == 0) {
+        // Keep the stream clean, anything else printed goes to stderr
+        int streamFd = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        output.file = fdopen(streamFd, "wb");
+    }
+    else {
+        output.file = fopen(path, "wb");
+    }
+    if (!output.file) {
+        fprintf(stderr, "Error: Could not create \"%s\"\n", path);
+        return false;
+    }
+
+    if (output.format == FORMAT_Y4M)
+        fprintf(output.file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C444\n", options.width, options.height, options.fps);
+
+    return true;
+}
+
+static int render_spectrum(const offscreen_options &options, const char *input_path, const char *output_path) {
+    recidia_spectrum_header header;
+    size_t fileSize;
+    const float *spectrum = map_spectrum_file(input_path, header, fileSize);
+    if (!spectrum)
+        return EXIT_FAILURE;
+
+    // Drawn at the scale it was analyzed with
+    recidia_settings.data.height_cap = header.height_cap;
+
+    // Spectrum frame "i" ends at sample (i+1) * hop_size
+    double spectrumRate = (double) header.sample_rate / header.hop_size;
+    u_int64_t framesCount = (header.frames_count * header.hop_size * options.fps) / header.sample_rate;
+
+    offscreen_output output;
+    if (!framesCount || !open_output(output, options, output_path)) {
+        if (!framesCount)
+            fprintf(stderr, "Error: \"%s\" is shorter than one frame\n", input_path);
+        munmap((char*) spectrum - header.header_size, fileSize);
+        return EXIT_FAILURE;
+    }
+
+    float mainColor[4], backColor[4];
+    set_linear_color(mainColor, recidia_settings.design.main_color);
+    set_linear_color(backColor, recidia_settings.design.back_color);
+
+    offscreen_renderer renderer;
+    bool failed = false;
+    auto timerStart = utime_now();
+    try {
+        init_renderer(renderer, options);
+
+        recidia_plots_history plotsHistory = {};
+        u_int64_t drawnCurrent = UINT64_MAX;
+        u_int64_t written = 0;
+        for (u_int64_t f=0; f < framesCount + OFFSCREEN_FRAMES && !failed; f++) {
+            uint slot = f % OFFSCREEN_FRAMES;
+            offscreen_frame &frame = renderer.frames[slot];
+
+            // The other frames keep rendering while this one is written out
+            if (frame.rendering) {
+                dev_funct->vkWaitForFences(vulkan_dev, 1, &frame.fence, VK_TRUE, UINT64_MAX);
+                frame.rendering = false;
+                failed = !write_frame(output, frame, written, options);
+                written++;
+            }
+            if (f >= framesCount || failed)
+                continue;
+
+            // Blend between the spectrum frames around this frame's time
+            double position = max(((double) f / options.fps) * spectrumRate - 1.0, 0.0);
+            u_int64_t previous = min((u_int64_t) position, header.frames_count - 1);
+            u_int64_t current = min(previous + 1, header.frames_count - 1);
+            float blend = position - previous;
+
+            const float *previousPlots = spectrum + (previous * header.plots_count);
+            const float *currentPlots = spectrum + (current * header.plots_count);
+            plotsHistory.previous.assign(previousPlots, previousPlots + header.plots_count);
+            plotsHistory.current.assign(currentPlots, currentPlots + header.plots_count);
+            get_power_stats(currentPlots, header.plots_count, plotsHistory.power_stats);
+
+            // Like the GUI, a spectrogram row per spectrum frame, also the ones between drawn frames
+            u_int64_t firstNew = (drawnCurrent == UINT64_MAX) ? current : drawnCurrent + 1;
+            uint newRowsCount = (current >= firstNew) ? current - firstNew + 1 : 0;
+            render_frame(renderer, slot, options, plotsHistory, spectrum + (firstNew * header.plots_count),
+                         newRowsCount, blend, (f * 1000000) / options.fps, mainColor, backColor);
+            drawnCurrent = current;
+        }
+    }
+    catch (const std::runtime_error &ex) {
+        fprintf(stderr, "Error: %s\n", ex.what());
+        failed = true;
+    }
+    release_renderer(renderer);
+
+    if (output.file && fclose(output.file) != 0)
+        failed = true;
+    munmap((char*) spectrum - header.header_size, fileSize);
+
+    if (failed)
+        return EXIT_FAILURE;
+
+    double seconds = (double) (utime_now() - timerStart) / 1000000;
+    fprintf(stderr, "%llu frames of %ux%u in %.3fs (%.0f frames/s)\n", (unsigned long long) framesCount,
+            options.width, options.height, seconds, framesCount / seconds);
+
+    return EXIT_SUCCESS;
+}
+
+static void print_offscreen_usage() {
+    fprintf(stderr, "Usage: recidia --render [options] <input.rsf> <output>\n"
+                    "  -s, --size <WxH>       Frame size (default 1280x720)\n"
+                    "  -r, --fps <rate>       Frames per second (default 60)\n"
+                    "  -f, --format <format>  y4m, rgba or png (default y4m)\n"
+                    "Output is a file or \"-\" for stdout, png writes numbered frames into the output dir\n");
+}
+
+// argv[0] is "--render"
+int init_offscreen(int argc, char **argv) {
+    offscreen_options options;
+    options.width = 1280;
+    options.height = 720;
+    options.fps = 60;
+    options.format = FORMAT_Y4M;
+
+    static const struct option longOptions[] = {
+        {"size", required_argument, NULL, 's'},
+        {"fps", required_argument, NULL, 'r'},
+        {"format", required_argument, NULL, 'f'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "s:r:f:h", longOptions, NULL)) != -1) {
+        switch (opt) {
+            case 's':
+                if (sscanf(optarg, "%ux%u", &options.width, &options.height) != 2) {
+                    print_offscreen_usage();
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'r':
+                options.fps = atoi(optarg);
+                break;
+            case 'f':
+                if (strcmp(optarg, "y4m") == 0)
+                    options.format = FORMAT_Y4M;
+                else if (strcmp(optarg, "rgba") == 0)
+                    options.format = FORMAT_RGBA;
+                else if (strcmp(optarg, "png") == 0)
+                    options.format = FORMAT_PNG;
+                else {
+                    print_offscreen_usage();
+                    return EXIT_FAILURE;
+                }
+                break;
+            default:
+                print_offscreen_usage();
+                return EXIT_FAILURE;
+        }
+    }
+    if (argc - optind != 2 || !options.width || !options.height || !options.fps) {
+        print_offscreen_usage();
+        return EXIT_FAILURE;
+    }
+
+    return render_spectrum(options, argv[optind], argv[optind+1]);
+}
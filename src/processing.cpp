@@ -3,27 +3,27 @@
 #include <algorithm>
 #include <vector>
 
-#include <fftw3.h>
 #include <gsl/gsl_linalg.h>
 
-#include <recidia.h>
+#include <processing.hpp>
 
 using namespace std;
 
-static void create_chart_table(uint chart_size, uint *chart_table, recidia_audio_data *audio_data) {
+void create_chart_table(uint chart_size, uint *chart_table, uint sample_rate, uint buffer_size,
+                        const struct recidia_chart_guide &chart_guide) {
 
     uint i, j;
 
-    float beizerTable[chart_size];
+    float beizerTable[chart_size+1];
 
-    float plotFreq = (float) audio_data->sample_rate / (float) recidia_settings.data.audio_buffer_size;
+    float plotFreq = (float) sample_rate / (float) buffer_size;
 
-    float startPoint = recidia_settings.data.chart_guide.start_freq / plotFreq;
-    float startCtrl = startPoint * recidia_settings.data.chart_guide.start_ctrl;
-    float midPoint = recidia_settings.data.chart_guide.mid_freq / plotFreq;
-    uint midPointPos = round(chart_size * recidia_settings.data.chart_guide.mid_pos);
-    float midCtrl = midPoint * recidia_settings.data.chart_guide.end_ctrl;
-    float endPoint = recidia_settings.data.chart_guide.end_freq / plotFreq;
+    float startPoint = chart_guide.start_freq / plotFreq;
+    float startCtrl = startPoint * chart_guide.start_ctrl;
+    float midPoint = chart_guide.mid_freq / plotFreq;
+    uint midPointPos = round(chart_size * chart_guide.mid_pos);
+    float midCtrl = midPoint * chart_guide.end_ctrl;
+    float endPoint = chart_guide.end_freq / plotFreq;
 
     uint samples;
     float p0, p2, c, n;
@@ -53,7 +53,7 @@ static void create_chart_table(uint chart_size, uint *chart_table, recidia_audio
     }
 
     float stepSize = 1;
-    float limit = (float) recidia_settings.data.audio_buffer_size / 2;
+    float limit = (float) buffer_size / 2;
     float prevStep;
     float nextStep = beizerTable[0];
     chart_table[0] = (uint) beizerTable[0];
@@ -155,7 +155,7 @@ static gsl_matrix* moore_penrose_pinv(gsl_matrix *A, const double rcond) {
     return A_pinv;
 }
 
-static vector<float> get_savgol_coeffs(int window_size, int poly_order ) {
+vector<float> get_savgol_coeffs(int window_size, int poly_order ) {
     const int halfWindow = (window_size - 1) / 2;
 
     gsl_matrix *A = gsl_matrix_alloc(window_size, poly_order+1);
@@ -185,169 +185,88 @@ static vector<float> get_savgol_coeffs(int window_size, int poly_order ) {
 //[[ 1 -2  4 -8] [ 1 -1  1 -1] [ 1  0  0  0] [ 1  1  1  1] [ 1  2  4  8]]
 // [-0.08571429  0.34285714  0.48571429  0.34285714 -0.08571429]
 
-void init_processing(recidia_audio_data *audio_data) {
-    // Allocate Default Vars
-    uint i, j;
-    uint interpIndex = 0;
-
-    // Copy of some settings
-    uint audioBufferSize = recidia_settings.data.audio_buffer_size;
-    uint interp = recidia_settings.data.interp;
-    uint plotsCount = recidia_data.plots_count;
-    float savgolRelativeWindowSize = recidia_settings.data.savgol_filter.window_size;
-    uint savgolWindowSize = savgolRelativeWindowSize * plotsCount;
-
-    double *fftIn = (double*) fftw_malloc(sizeof(double) * recidia_settings.data.AUDIO_BUFFER_SIZE.MAX);
-    double *fftOut = (double*) fftw_malloc(sizeof(double) * recidia_settings.data.AUDIO_BUFFER_SIZE.MAX);
-    fftw_plan fftPlan = fftw_plan_r2r_1d(audioBufferSize, fftIn, fftOut, FFTW_R2HC, FFTW_MEASURE);
-
-    float interpArray[recidia_settings.data.INTERP.MAX][recidia_settings.data.AUDIO_BUFFER_SIZE.MAX/2];
-    float proArray[recidia_settings.data.AUDIO_BUFFER_SIZE.MAX/2];
-    uint chartTable[recidia_settings.data.AUDIO_BUFFER_SIZE.MAX/2];
-    vector<float> pinvVector;
-
-    create_chart_table(plotsCount, chartTable, audio_data);
-    if (recidia_settings.data.savgol_filter.window_size > recidia_settings.data.savgol_filter.poly_order + 1)
-        pinvVector = get_savgol_coeffs(savgolWindowSize, recidia_settings.data.savgol_filter.poly_order);
-
-    while (1) {
-        auto timerStart = utime_now();
-
-        // Handling volatile vars
-        if (audioBufferSize != recidia_settings.data.audio_buffer_size) {
-            audioBufferSize = recidia_settings.data.audio_buffer_size;
-
-            fftw_destroy_plan(fftPlan);
-            fftPlan = fftw_plan_r2r_1d(audioBufferSize, fftIn, fftOut, FFTW_R2HC, FFTW_MEASURE);
-            create_chart_table(plotsCount, chartTable, audio_data);
-        }
-        if (interp != recidia_settings.data.interp) {
-            interp = recidia_settings.data.interp;
-
-            interpIndex = 0;
-        }
-        if (plotsCount != recidia_data.plots_count) {
-            plotsCount = recidia_data.plots_count;
-
-            if (savgolRelativeWindowSize) {
-                savgolWindowSize = savgolRelativeWindowSize * plotsCount;
-                if (savgolWindowSize % 2 == 0) savgolWindowSize += 1;
-                if (savgolWindowSize < recidia_settings.data.savgol_filter.poly_order+2)
-                    savgolWindowSize = recidia_settings.data.savgol_filter.poly_order+2;
-                pinvVector = get_savgol_coeffs(savgolWindowSize, recidia_settings.data.savgol_filter.poly_order);
-            }
-
-            create_chart_table(plotsCount, chartTable, audio_data);
-        }
-        if (savgolRelativeWindowSize != recidia_settings.data.savgol_filter.window_size) {
-            savgolRelativeWindowSize = recidia_settings.data.savgol_filter.window_size;
-
-            if (savgolRelativeWindowSize) {
-                savgolWindowSize = savgolRelativeWindowSize * plotsCount;
-                if (savgolWindowSize % 2 == 0) savgolWindowSize += 1;
-                if (savgolWindowSize < recidia_settings.data.savgol_filter.poly_order+2)
-                    savgolWindowSize = recidia_settings.data.savgol_filter.poly_order+2;
-                pinvVector = get_savgol_coeffs(savgolWindowSize, recidia_settings.data.savgol_filter.poly_order);
-            }
-            else
-                savgolWindowSize = 0;
-        }
-        
+uint get_savgol_window_size(float relative_size, uint plots_count, uint poly_order) {
+    if (!relative_size)
+        return 0;
 
-        // Copy audio data and run FFT
-        copy(audio_data->samples, audio_data->samples+audioBufferSize, fftIn);
+    uint windowSize = relative_size * plots_count;
+    if (windowSize % 2 == 0) windowSize += 1;
+    if (windowSize < poly_order+2)
+        windowSize = poly_order+2;
 
-        // For latency display
-        recidia_data.start_time = utime_now();
-        
-        fftw_execute(fftPlan);
-
-        // Absolute and normalized of FFT output
-        for (i=1; i < audioBufferSize / 2; i++ ) {
-            // i is +1 to throw away fftOut[0] and only half the data is usable
-            fftOut[i-1] = abs(fftOut[i]) / (double) audioBufferSize;
-        }
-
-
-        // Apply plot table by using max num between plots
-        for (i=0; i < plotsCount; i++) {
-            uint minNum = chartTable[i];
-            uint maxNum = chartTable[i+1];
+    return windowSize;
+}
 
-            if (maxNum > minNum)
-                proArray[i] = *max_element(fftOut + minNum, fftOut + maxNum);
-            else
-                proArray[i] = *max_element(fftOut + maxNum, fftOut + minNum);
-        }
+void normalize_fft_output(double *fft_out, uint buffer_size) {
+    // Absolute and normalized of FFT output
+    for (uint i=1; i < buffer_size / 2; i++ ) {
+        // i is +1 to throw away fft_out[0] and only half the data is usable
+        fft_out[i-1] = abs(fft_out[i]) / (double) buffer_size;
+    }
+}
 
+void apply_chart_table(const double *fft_out, const uint *chart_table, uint plots_count, float *plots) {
+    // Apply plot table by using max num between plots
+    for (uint i=0; i < plots_count; i++) {
+        uint minNum = chart_table[i];
+        uint maxNum = chart_table[i+1];
 
-        // Savitzky Golay Filter
-        if (savgolWindowSize >= recidia_settings.data.savgol_filter.poly_order + 2) {
-            // auto benchStart = utime_now();
-
-            int halfWindow = (savgolWindowSize - 1) / 2;
-
-            vector<float> filterIn(proArray, proArray+plotsCount);
-            // Pad signal at extremes
-            vector<float>::const_iterator front, back;
-            front = filterIn.begin() + 1;
-            back = filterIn.begin() + halfWindow + 1;
-            vector<float> frontPad(front, back);
-            front = filterIn.end() -  halfWindow - 1;
-            back = filterIn.end() - 1;
-            vector<float> backPad(front, back);
-            filterIn.insert(filterIn.begin(), frontPad.begin(), frontPad.end());
-            filterIn.insert(filterIn.end(), backPad.begin(), backPad.end());
-
-            // Convolve
-            int const nf = pinvVector.size();
-            int const ng = filterIn.size();
-            vector<float> min_v = (nf < ng)? pinvVector : filterIn;
-            vector<float> max_v = (nf < ng)? filterIn : pinvVector;
-            int const n  = max(nf, ng) - min(nf, ng) + 1;
-            vector<float> filterOut(n);
-            for(auto i(0); i < n; ++i) {
-                for(int j(min_v.size() - 1), k(i); j >= 0; --j) {
-                    if (min_v[j] > 0 && max_v[k] > 0)
-                        filterOut[i] += min_v[j] * max_v[k]; // No negative nums
-                    ++k;
-                }
-            }
-            copy(filterOut.begin(), filterOut.end(), proArray);
+        if (maxNum > minNum)
+            plots[i] = *max_element(fft_out + minNum, fft_out + maxNum);
+        else
+            plots[i] = *max_element(fft_out + maxNum, fft_out + minNum);
+    }
+}
 
-            // printf("Savgol: %li \n", (utime_now() - benchStart));
+void apply_savgol_filter(float *plots, uint plots_count, const vector<float> &coeffs, vector<float> &scratch) {
+    int halfWindow = (coeffs.size() - 1) / 2;
+
+    // Pad signal at extremes
+    vector<float> &filterIn = scratch;
+    filterIn.resize(plots_count + (halfWindow * 2));
+    copy(plots + 1, plots + halfWindow + 1, filterIn.begin());
+    copy(plots, plots + plots_count, filterIn.begin() + halfWindow);
+    copy(plots + plots_count - halfWindow - 1, plots + plots_count - 1, filterIn.begin() + halfWindow + plots_count);
+
+    // Convolve
+    int const nf = coeffs.size();
+    int const ng = filterIn.size();
+    vector<float> const &min_v = (nf < ng)? coeffs : filterIn;
+    vector<float> const &max_v = (nf < ng)? filterIn : coeffs;
+    int const n  = max(nf, ng) - min(nf, ng) + 1;
+    for(auto i(0); i < n; ++i) {
+        float sum = 0;
+        for(int j(min_v.size() - 1), k(i); j >= 0; --j) {
+            if (min_v[j] > 0 && max_v[k] > 0)
+                sum += min_v[j] * max_v[k]; // No negative nums
+            ++k;
         }
+        plots[i] = sum;
+    }
+}
 
+void apply_interpolation(float *plots, uint plots_count, float *interp_history, uint history_stride,
+                         uint interp, uint &interp_index) {
+    if (!interp)
+        return;
 
-        // Interpolation
-        if (interp) {
-            copy(proArray, proArray+plotsCount, interpArray[interpIndex]);
-
-            for (j=0; j < interp; j++ ) {
-                if (j != interpIndex) {
-                    for (i=0; i < plotsCount; i++ ) {
-                        proArray[i] += interpArray[j][i];
-                    }
-                }
-            }
-            for (i=0; i < plotsCount; i++ ) {
-                proArray[i] /= interp;
-            }
+    float *history;
+    copy(plots, plots+plots_count, interp_history + (interp_index * history_stride));
 
-            interpIndex++;
-            if (interpIndex >= interp) {
-                interpIndex = 0;
+    for (uint j=0; j < interp; j++ ) {
+        if (j != interp_index) {
+            history = interp_history + (j * history_stride);
+            for (uint i=0; i < plots_count; i++ ) {
+                plots[i] += history[i];
             }
         }
+    }
+    for (uint i=0; i < plots_count; i++ ) {
+        plots[i] /= interp;
+    }
 
-        // Send out plots
-        copy(proArray, proArray + plotsCount, recidia_data.plots);
-        
-
-        // Sleep for poll time
-        uint latency = utime_now() - timerStart;
-        int sleepTime = ((recidia_settings.data.poll_rate * 1000) - latency);
-        if (sleepTime > 0)
-            usleep(sleepTime);
+    interp_index++;
+    if (interp_index >= interp) {
+        interp_index = 0;
     }
 }
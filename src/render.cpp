@@ -0,0 +1,1052 @@
+#include <fstream>
+#include <cstring>
+#include <cstddef>
+#include <cmath>
+#include <memory>
+#include <algorithm>
+#include <filesystem>
+#include <sstream>
+#include <unistd.h>
+
+#include <glm/glm.hpp>
+#include <shaderc/shaderc.hpp>
+
+#include <render.hpp>
+#include <recidia.h>
+
+using namespace std;
+
+// Build time shaderc version, part of the SPIR-V cache key
+#ifndef SHADERC_VERSION
+#define SHADERC_VERSION "unknown"
+#endif
+
+VkDevice vulkan_dev;
+VulkanDeviceFunctions *dev_funct;
+static VulkanDeviceFunctions device_functions;
+static VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+static filesystem::path pipeline_cache_path;
+
+// Matches "PushConstants" in shaders/recidia.glsl
+struct PushConstants {
+    glm::float32 time;
+    glm::float32 power;
+    glm::uint32 plots_count;
+    glm::int32 draw_mode;
+    glm::vec4 color;
+    glm::vec2 origin;
+    glm::float32 plot_width;
+    glm::float32 step;
+    glm::float32 height_scale;
+    glm::float32 min_height;
+    glm::float32 max_height;
+    glm::float32 blend;
+    glm::uint32 newest_row;
+    glm::uint32 curve_subdivisions;
+    glm::int32 plots_layout;
+    glm::float32 inner_radius;
+    glm::float32 start_angle;
+    glm::float32 aspect;
+};
+static_assert(offsetof(PushConstants, color) == 16, "vec4 must be 16 byte aligned");
+static_assert(offsetof(PushConstants, origin) == 32, "vec2 must be 8 byte aligned");
+static_assert(sizeof(PushConstants) <= 128, "Only 128 bytes of push constants are guaranteed");
+static_assert(sizeof(recidia_power_stats) == 32, "Must match the std140 \"Audio\" block in shaders/recidia.glsl");
+
+// Past the user's draw modes
+const int DRAW_BACKGROUND = 4;
+// Vertices of each plot's quad, see shaders/recidia.glsl
+const uint QUAD_VERTICES_COUNT = 6;
+
+// Plots heights read by the vertex shaders, a slice per frame in flight
+uint PLOTS_BUFFER_SIZE = sizeof(float);
+static bool BUFFERS_SIZE_FINALIZED = false;
+
+// Set "const" buffer sizes
+void finalize_buffers_size() {
+    if (!BUFFERS_SIZE_FINALIZED) {
+        PLOTS_BUFFER_SIZE *= recidia_settings.data.AUDIO_BUFFER_SIZE.MAX / 2;
+
+        BUFFERS_SIZE_FINALIZED = true;
+    }
+}
+
+bool init_render_device(VkDevice device, PFN_vkGetDeviceProcAddr get_device_proc_addr) {
+    vulkan_dev = device;
+    dev_funct = &device_functions;
+
+    bool loaded = true;
+#define RECIDIA_LOAD_DEVICE_FUNCTION(name) \
+    device_functions.name = (PFN_##name) get_device_proc_addr(device, #name); \
+    if (!device_functions.name) { \
+        printf("Failed to load %s\n", #name); \
+        loaded = false; \
+    }
+    RECIDIA_DEVICE_FUNCTIONS(RECIDIA_LOAD_DEVICE_FUNCTION)
+#undef RECIDIA_LOAD_DEVICE_FUNCTION
+
+    return loaded;
+}
+
+vector<string> get_shader_locations() {
+    string homeDir = getenv("HOME");
+    return {"shaders/",
+            "../shaders/",
+            homeDir + "/.config/recidia/shaders/",
+            "/etc/recidia/shaders/"};
+}
+
+static bool read_shader_file(const string &name, string &shader_text) {
+    vector<string> shaderFileLocations = get_shader_locations();
+    // Read shader file
+    ifstream file;
+    for (uint i=0; i < shaderFileLocations.size(); i++) {
+        file.open(shaderFileLocations[i] + name);
+        if (file.is_open())
+            break;
+    }
+    if (!file.is_open())
+        return false;
+
+    shader_text.assign( (std::istreambuf_iterator<char>(file) ),
+                        (std::istreambuf_iterator<char>()    ) );
+    file.close();
+
+    return true;
+}
+
+// Only "time" animates, "power" follows the plots
+bool is_animated_shader(const string &vertex, const string &frag) {
+    string shaderText;
+    for (const string &name : {vertex, frag}) {
+        if (read_shader_file(name, shaderText) && shaderText.find(".time") != string::npos)
+            return true;
+    }
+    return false;
+}
+
+bool is_animated_shader(const shader_setting &shader) {
+    return is_animated_shader(shader.vertex ? shader.vertex : "default.vert", shader.frag ? shader.frag : "default.frag");
+}
+
+// Resolves #include "recidia.glsl" from the same locations as the shaders
+class ShaderIncluder : public shaderc::CompileOptions::IncluderInterface {
+
+    struct IncludeData {
+        shaderc_include_result result;
+        string name;
+        string content;
+    };
+
+    shaderc_include_result *GetInclude(const char *requested_source, shaderc_include_type type,
+                                       const char *requesting_source, size_t include_depth) override {
+        (void) type;
+        (void) requesting_source;
+        (void) include_depth;
+
+        IncludeData *data = new IncludeData;
+        if (read_shader_file(requested_source, data->content))
+            data->name = requested_source;
+        else
+            data->content = "Failed to find include file!"; // Empty name means error
+
+        data->result.source_name = data->name.c_str();
+        data->result.source_name_length = data->name.length();
+        data->result.content = data->content.c_str();
+        data->result.content_length = data->content.length();
+        data->result.user_data = data;
+
+        return &data->result;
+    }
+
+    void ReleaseInclude(shaderc_include_result *data) override {
+        delete (IncludeData*) data->user_data;
+    }
+};
+
+// $XDG_CACHE_HOME/recidia/ or ~/.cache/recidia/
+static filesystem::path get_cache_dir() {
+    const char *cacheHome = getenv("XDG_CACHE_HOME");
+    if (cacheHome && cacheHome[0])
+        return filesystem::path(cacheHome) / "recidia";
+
+    return filesystem::path(getenv("HOME")) / ".cache" / "recidia";
+}
+
+static bool read_cache_file(const filesystem::path &path, vector<char> &data) {
+    ifstream file(path, ios::binary);
+    if (!file.is_open())
+        return false;
+
+    data.assign( (std::istreambuf_iterator<char>(file) ),
+                 (std::istreambuf_iterator<char>()    ) );
+    return !file.bad();
+}
+
+// Written beside then renamed, so other instances never read a partial file
+static void write_cache_file(const filesystem::path &path, const void *data, size_t size) {
+    error_code ec;
+    filesystem::create_directories(path.parent_path(), ec);
+
+    filesystem::path tmpPath = path;
+    tmpPath += ".tmp" + to_string(getpid());
+
+    ofstream file(tmpPath, ios::binary);
+    if (!file.is_open())
+        return;
+    file.write((const char*) data, size);
+    file.close();
+
+    if (file.fail())
+        filesystem::remove(tmpPath, ec);
+    else
+        filesystem::rename(tmpPath, path, ec);
+}
+
+// FNV-1a
+static void hash_bytes(u_int64_t &hash, const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char*) data;
+    for (size_t i=0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+}
+
+// Hashes the source and, like the includer finds them, every file it includes
+static void hash_shader_source(u_int64_t &hash, const string &shader_text, uint depth) {
+    hash_bytes(hash, shader_text.data(), shader_text.size());
+    if (depth > 8)
+        return;
+
+    istringstream lines(shader_text);
+    string line;
+    while (getline(lines, line)) {
+        size_t directive = line.find_first_not_of(" \t");
+        if (directive == string::npos || line.compare(directive, 8, "#include") != 0)
+            continue;
+
+        size_t nameStart = line.find('"', directive);
+        size_t nameEnd = line.find('"', nameStart + 1);
+        if (nameStart == string::npos || nameEnd == string::npos)
+            continue;
+
+        string includeText;
+        if (read_shader_file(line.substr(nameStart + 1, nameEnd - nameStart - 1), includeText))
+            hash_shader_source(hash, includeText, depth + 1);
+    }
+}
+
+// SPIR-V from the cache when the sources, shader kind and shaderc version match, else shaderc
+static bool get_spirv(const string &name, shaderc_shader_kind shader_kind, vector<uint32_t> &spv_code) {
+    string shaderText;
+    if (!read_shader_file(name, shaderText))
+        throw std::runtime_error("Failed to find shader file!");
+
+    u_int64_t hash = 14695981039346656037ULL;
+    hash_bytes(hash, SHADERC_VERSION, sizeof(SHADERC_VERSION));
+    hash_bytes(hash, &shader_kind, sizeof(shader_kind));
+    hash_shader_source(hash, shaderText, 0);
+
+    char hashName[32];
+    snprintf(hashName, sizeof(hashName), "%016llx.spv", (unsigned long long) hash);
+    filesystem::path cachePath = get_cache_dir() / "shaders" / hashName;
+
+    const uint32_t SPIRV_MAGIC = 0x07230203;
+    vector<char> cached;
+    if (read_cache_file(cachePath, cached) && cached.size() >= sizeof(uint32_t) * 5
+        && cached.size() % sizeof(uint32_t) == 0 && *(const uint32_t*) cached.data() == SPIRV_MAGIC) {
+
+        spv_code.resize(cached.size() / sizeof(uint32_t));
+        memcpy(spv_code.data(), cached.data(), cached.size());
+        return true;
+    }
+
+    shaderc::Compiler compiler;
+    shaderc::CompileOptions options;
+    options.SetIncluder(std::make_unique<ShaderIncluder>());
+
+    shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(shaderText, shader_kind, name.c_str(), options);
+    if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+        printf("Failed to compile shader: %s\n", result.GetErrorMessage().c_str());
+        return false;
+    }
+    spv_code.assign(result.cbegin(), result.cend());
+
+    write_cache_file(cachePath, spv_code.data(), sizeof(uint32_t) * spv_code.size());
+    return true;
+}
+
+static VkShaderModule createShader(const string name, shaderc_shader_kind shader_kind) {
+    vector<uint32_t> spvCode;
+    if (!get_spirv(name, shader_kind, spvCode))
+        return VK_NULL_HANDLE;
+
+    VkShaderModuleCreateInfo shaderInfo;
+    shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderInfo.codeSize = sizeof(uint32_t) * spvCode.size();
+    shaderInfo.pCode = (const uint32_t*) spvCode.data();
+    shaderInfo.pNext = nullptr; // WILL SEGV WITHOUT
+    shaderInfo.flags = 0;
+
+    VkShaderModule shaderModule;
+    VkResult err = dev_funct->vkCreateShaderModule(vulkan_dev, &shaderInfo, nullptr, &shaderModule);
+    if (err != VK_SUCCESS) {
+        printf("Failed to create shader module: %d\n", err);
+        return VK_NULL_HANDLE;
+    }
+
+    return shaderModule;
+}
+
+// Named by the driver's cache UUID, a driver update starts a new cache
+static filesystem::path get_pipeline_cache_path(const VkPhysicalDeviceProperties &properties) {
+    string uuid;
+    char hex[3];
+    for (uint i=0; i < VK_UUID_SIZE; i++) {
+        snprintf(hex, sizeof(hex), "%02x", properties.pipelineCacheUUID[i]);
+        uuid += hex;
+    }
+    return get_cache_dir() / ("pipelines-" + uuid + ".bin");
+}
+
+void create_pipeline_cache(const VkPhysicalDeviceProperties &properties) {
+    pipeline_cache_path = get_pipeline_cache_path(properties);
+
+    // Vulkan checks the header itself and ignores data from another device
+    vector<char> cacheData;
+    read_cache_file(pipeline_cache_path, cacheData);
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = cacheData.size();
+    cacheInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+    VkResult err = dev_funct->vkCreatePipelineCache(vulkan_dev, &cacheInfo, nullptr, &pipeline_cache);
+    if (err != VK_SUCCESS) {
+        printf("Failed to create pipeline cache: %d\n", err);
+        pipeline_cache = VK_NULL_HANDLE;
+    }
+}
+
+static void save_pipeline_cache() {
+    size_t size = 0;
+    if (dev_funct->vkGetPipelineCacheData(vulkan_dev, pipeline_cache, &size, nullptr) != VK_SUCCESS || !size)
+        return;
+
+    vector<char> cacheData(size);
+    if (dev_funct->vkGetPipelineCacheData(vulkan_dev, pipeline_cache, &size, cacheData.data()) != VK_SUCCESS)
+        return;
+
+    write_cache_file(pipeline_cache_path, cacheData.data(), size);
+}
+
+void release_pipeline_cache() {
+    if (!pipeline_cache)
+        return;
+
+    save_pipeline_cache();
+    dev_funct->vkDestroyPipelineCache(vulkan_dev, pipeline_cache, nullptr);
+    pipeline_cache = VK_NULL_HANDLE;
+}
+
+static inline VkDeviceSize aligned(VkDeviceSize v, VkDeviceSize byteAlign) {
+    return (v + byteAlign - 1) & ~(byteAlign - 1);
+}
+
+void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, uint32_t memory_index, VkBuffer& buffer,
+                  VkDeviceMemory& bufferMemory) {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (dev_funct->vkCreateBuffer(vulkan_dev, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create buffer!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        dev_funct->vkGetBufferMemoryRequirements(vulkan_dev, buffer, &memRequirements);
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = memory_index;
+
+        if (dev_funct->vkAllocateMemory(vulkan_dev, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate buffer memory!");
+        }
+
+        dev_funct->vkBindBufferMemory(vulkan_dev, buffer, bufferMemory, 0);
+    }
+
+void create_frame_resources(FrameResources &resources, int frames_count, const VkPhysicalDeviceLimits &limits,
+                            uint32_t memory_index) {
+    VkResult err;
+
+    VkDeviceSize sliceAlign = max(limits.minStorageBufferOffsetAlignment, limits.minUniformBufferOffsetAlignment);
+    VkDeviceSize plotsSize = aligned(PLOTS_BUFFER_SIZE, sliceAlign);
+    VkDeviceSize audioSize = aligned(sizeof(recidia_power_stats), sliceAlign);
+    VkDeviceSize sliceSize = (plotsSize * 2) + audioSize;
+
+    createBuffer(sliceSize * frames_count, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                 memory_index, resources.buffer, resources.memory);
+
+    void *plotsData;
+    err = dev_funct->vkMapMemory(vulkan_dev, resources.memory, 0, VK_WHOLE_SIZE, 0, &plotsData);
+    if (err != VK_SUCCESS)
+        throw std::runtime_error("Failed to map memory!");
+
+    VkDescriptorBufferInfo plotsBufInfo[RENDER_MAX_FRAMES][2];
+    VkDescriptorBufferInfo audioBufInfo[RENDER_MAX_FRAMES];
+    for (int i=0; i < frames_count; i++) {
+        for (int j=0; j < 2; j++) {
+            resources.plots_slices[i][j] = (float*) ((char*) plotsData + (sliceSize * i) + (plotsSize * j));
+
+            plotsBufInfo[i][j].buffer = resources.buffer;
+            plotsBufInfo[i][j].offset = (sliceSize * i) + (plotsSize * j);
+            plotsBufInfo[i][j].range = PLOTS_BUFFER_SIZE;
+        }
+        resources.audio_slices[i] = (char*) plotsData + (sliceSize * i) + (plotsSize * 2);
+        memset(resources.audio_slices[i], 0, sizeof(recidia_power_stats));
+
+        audioBufInfo[i].buffer = resources.buffer;
+        audioBufInfo[i].offset = (sliceSize * i) + (plotsSize * 2);
+        audioBufInfo[i].range = sizeof(recidia_power_stats);
+    }
+
+    // Current and previous plots buffers for the vertex shaders, audio uniforms for all
+    // The spectrogram texture is written by create_spectrogram()
+    VkDescriptorSetLayoutBinding layoutBindings[4]{};
+    for (uint j=0; j < 2; j++) {
+        layoutBindings[j].binding = j;
+        layoutBindings[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        layoutBindings[j].descriptorCount = 1;
+        layoutBindings[j].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    }
+    layoutBindings[2].binding = 2;
+    layoutBindings[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    layoutBindings[2].descriptorCount = 1;
+    layoutBindings[2].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    layoutBindings[3].binding = 3;
+    layoutBindings[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    layoutBindings[3].descriptorCount = 1;
+    layoutBindings[3].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutCreateInfo descLayoutInfo{};
+    descLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descLayoutInfo.bindingCount = 4;
+    descLayoutInfo.pBindings = layoutBindings;
+    err = dev_funct->vkCreateDescriptorSetLayout(vulkan_dev, &descLayoutInfo, nullptr, &resources.desc_set_layout);
+    if (err != VK_SUCCESS)
+        throw std::runtime_error("Failed to create descriptor set layout!");
+
+    VkDescriptorPoolSize descPoolSizes[3]{};
+    descPoolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descPoolSizes[0].descriptorCount = frames_count * 2;
+    descPoolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descPoolSizes[1].descriptorCount = frames_count;
+    descPoolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descPoolSizes[2].descriptorCount = frames_count;
+
+    VkDescriptorPoolCreateInfo descPoolInfo{};
+    descPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descPoolInfo.maxSets = frames_count;
+    descPoolInfo.poolSizeCount = 3;
+    descPoolInfo.pPoolSizes = descPoolSizes;
+    err = dev_funct->vkCreateDescriptorPool(vulkan_dev, &descPoolInfo, nullptr, &resources.desc_pool);
+    if (err != VK_SUCCESS)
+        throw std::runtime_error("Failed to create descriptor pool!");
+
+    for (int i=0; i < frames_count; i++) {
+        VkDescriptorSetAllocateInfo descSetAllocInfo{};
+        descSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descSetAllocInfo.descriptorPool = resources.desc_pool;
+        descSetAllocInfo.descriptorSetCount = 1;
+        descSetAllocInfo.pSetLayouts = &resources.desc_set_layout;
+        err = dev_funct->vkAllocateDescriptorSets(vulkan_dev, &descSetAllocInfo, &resources.desc_sets[i]);
+        if (err != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate descriptor set!");
+
+        // Consecutive bindings, "plotsBufInfo[i]" fills both
+        VkWriteDescriptorSet descWrites[2]{};
+        descWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descWrites[0].dstSet = resources.desc_sets[i];
+        descWrites[0].dstBinding = 0;
+        descWrites[0].descriptorCount = 2;
+        descWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descWrites[0].pBufferInfo = plotsBufInfo[i];
+
+        descWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descWrites[1].dstSet = resources.desc_sets[i];
+        descWrites[1].dstBinding = 2;
+        descWrites[1].descriptorCount = 1;
+        descWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descWrites[1].pBufferInfo = &audioBufInfo[i];
+        dev_funct->vkUpdateDescriptorSets(vulkan_dev, 2, descWrites, 0, nullptr);
+    }
+}
+
+void release_frame_resources(FrameResources &resources) {
+    if (resources.desc_set_layout) {
+        dev_funct->vkDestroyDescriptorSetLayout(vulkan_dev, resources.desc_set_layout, nullptr);
+        resources.desc_set_layout = VK_NULL_HANDLE;
+    }
+
+    if (resources.desc_pool) {
+        dev_funct->vkDestroyDescriptorPool(vulkan_dev, resources.desc_pool, nullptr);
+        resources.desc_pool = VK_NULL_HANDLE;
+    }
+
+    if (resources.buffer) {
+        dev_funct->vkDestroyBuffer(vulkan_dev, resources.buffer, nullptr);
+        resources.buffer = VK_NULL_HANDLE;
+    }
+
+    if (resources.memory) {
+        dev_funct->vkUnmapMemory(vulkan_dev, resources.memory);
+        dev_funct->vkFreeMemory(vulkan_dev, resources.memory, nullptr);
+        resources.memory = VK_NULL_HANDLE;
+    }
+}
+
+bool find_memory_type(const VkPhysicalDeviceMemoryProperties &properties, uint32_t type_bits,
+                      VkMemoryPropertyFlags flags, uint32_t &index) {
+    for (uint32_t i=0; i < properties.memoryTypeCount; i++) {
+        if ((type_bits & (1 << i)) && (properties.memoryTypes[i].propertyFlags & flags) == flags) {
+            index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void create_spectrogram(SpectrogramResources &spectrogram, FrameResources &resources, int frames_count,
+                        const VkPhysicalDeviceLimits &limits, const VkPhysicalDeviceMemoryProperties &memory_properties) {
+    VkResult err;
+
+    // A texel per plot, R8 is always filterable and matches the 256 steps of the colormap
+    spectrogram.width = min((uint32_t) (PLOTS_BUFFER_SIZE / sizeof(float)), limits.maxImageDimension2D);
+    spectrogram.newest_row = 0;
+    spectrogram.columns = 0;
+    spectrogram.cleared = false;
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R8_UNORM;
+    imageInfo.extent = {spectrogram.width, SPECTROGRAM_ROWS, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (dev_funct->vkCreateImage(vulkan_dev, &imageInfo, nullptr, &spectrogram.image) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create spectrogram image!");
+
+    VkMemoryRequirements memRequirements;
+    dev_funct->vkGetImageMemoryRequirements(vulkan_dev, spectrogram.image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    if (!find_memory_type(memory_properties, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                          allocInfo.memoryTypeIndex)
+        && !find_memory_type(memory_properties, memRequirements.memoryTypeBits, 0, allocInfo.memoryTypeIndex))
+        throw std::runtime_error("No memory for the spectrogram image!");
+    if (dev_funct->vkAllocateMemory(vulkan_dev, &allocInfo, nullptr, &spectrogram.image_memory) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate spectrogram memory!");
+    dev_funct->vkBindImageMemory(vulkan_dev, spectrogram.image, spectrogram.image_memory, 0);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = spectrogram.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R8_UNORM;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 1;
+    if (dev_funct->vkCreateImageView(vulkan_dev, &viewInfo, nullptr, &spectrogram.image_view) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create spectrogram image view!");
+
+    // Rows repeat, so sampling past the newest row wraps around the ring
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = 0.0;
+    if (dev_funct->vkCreateSampler(vulkan_dev, &samplerInfo, nullptr, &spectrogram.sampler) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create spectrogram sampler!");
+
+    uint32_t stagingMemoryIndex;
+    if (!find_memory_type(memory_properties, ~0U,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                          stagingMemoryIndex))
+        throw std::runtime_error("No host visible memory!");
+    createBuffer(spectrogram.width * SPECTROGRAM_UPLOAD_ROWS * frames_count, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 stagingMemoryIndex, spectrogram.staging, spectrogram.staging_memory);
+
+    void *stagingData;
+    err = dev_funct->vkMapMemory(vulkan_dev, spectrogram.staging_memory, 0, VK_WHOLE_SIZE, 0, &stagingData);
+    if (err != VK_SUCCESS)
+        throw std::runtime_error("Failed to map memory!");
+
+    VkDescriptorImageInfo imageDescInfo{};
+    imageDescInfo.sampler = spectrogram.sampler;
+    imageDescInfo.imageView = spectrogram.image_view;
+    imageDescInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    for (int i=0; i < frames_count; i++) {
+        spectrogram.row_slices[i] = (unsigned char*) stagingData + (spectrogram.width * SPECTROGRAM_UPLOAD_ROWS * i);
+
+        VkWriteDescriptorSet descWrite{};
+        descWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descWrite.dstSet = resources.desc_sets[i];
+        descWrite.dstBinding = 3;
+        descWrite.descriptorCount = 1;
+        descWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descWrite.pImageInfo = &imageDescInfo;
+        dev_funct->vkUpdateDescriptorSets(vulkan_dev, 1, &descWrite, 0, nullptr);
+    }
+}
+
+void release_spectrogram(SpectrogramResources &spectrogram) {
+    if (spectrogram.staging) {
+        dev_funct->vkDestroyBuffer(vulkan_dev, spectrogram.staging, nullptr);
+        spectrogram.staging = VK_NULL_HANDLE;
+    }
+
+    if (spectrogram.staging_memory) {
+        dev_funct->vkUnmapMemory(vulkan_dev, spectrogram.staging_memory);
+        dev_funct->vkFreeMemory(vulkan_dev, spectrogram.staging_memory, nullptr);
+        spectrogram.staging_memory = VK_NULL_HANDLE;
+    }
+
+    if (spectrogram.sampler) {
+        dev_funct->vkDestroySampler(vulkan_dev, spectrogram.sampler, nullptr);
+        spectrogram.sampler = VK_NULL_HANDLE;
+    }
+
+    if (spectrogram.image_view) {
+        dev_funct->vkDestroyImageView(vulkan_dev, spectrogram.image_view, nullptr);
+        spectrogram.image_view = VK_NULL_HANDLE;
+    }
+
+    if (spectrogram.image) {
+        dev_funct->vkDestroyImage(vulkan_dev, spectrogram.image, nullptr);
+        spectrogram.image = VK_NULL_HANDLE;
+    }
+
+    if (spectrogram.image_memory) {
+        dev_funct->vkFreeMemory(vulkan_dev, spectrogram.image_memory, nullptr);
+        spectrogram.image_memory = VK_NULL_HANDLE;
+    }
+    spectrogram.cleared = false;
+}
+
+static void spectrogram_barrier(VkCommandBuffer &commandBuffer, VkImage image,
+                                VkImageLayout old_layout, VkImageLayout new_layout,
+                                VkAccessFlags src_access, VkAccessFlags dst_access,
+                                VkPipelineStageFlags src_stages, VkPipelineStageFlags dst_stages) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+    dev_funct->vkCmdPipelineBarrier(commandBuffer, src_stages, dst_stages, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void push_spectrogram_rows(VkCommandBuffer &commandBuffer, SpectrogramResources &spectrogram, int frame,
+                           const float *rows, uint rows_count, uint plots_count) {
+    const VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+                                              | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    uint columns = min(plots_count, spectrogram.width);
+    if (!columns || !rows_count)
+        return;
+
+    // More than the ring moves in a frame, only the newest fit
+    if (rows_count > SPECTROGRAM_UPLOAD_ROWS) {
+        rows += (rows_count - SPECTROGRAM_UPLOAD_ROWS) * plots_count;
+        rows_count = SPECTROGRAM_UPLOAD_ROWS;
+    }
+
+    // Relative to the height cap, like the bars' full height
+    unsigned char *slice = spectrogram.row_slices[frame];
+    float scale = 255.0 / recidia_settings.data.height_cap;
+    for (uint r=0; r < rows_count; r++) {
+        const float *plots = rows + (r * plots_count);
+        unsigned char *row = slice + (r * spectrogram.width);
+        for (uint i=0; i < columns; i++)
+            row[i] = (unsigned char) (min(max(plots[i] * scale, 0.0f), 255.0f) + 0.5f);
+    }
+
+    // Rows of another plots count no longer line up, start over from an empty ring
+    if (!spectrogram.cleared || columns != spectrogram.columns) {
+        spectrogram_barrier(commandBuffer, spectrogram.image, VK_IMAGE_LAYOUT_UNDEFINED,
+                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                            shaderStages, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        VkClearColorValue clearColor = {{0, 0, 0, 0}};
+        VkImageSubresourceRange range{};
+        range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        range.levelCount = 1;
+        range.layerCount = 1;
+        dev_funct->vkCmdClearColorImage(commandBuffer, spectrogram.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                        &clearColor, 1, &range);
+        // The clear and the copy both write
+        spectrogram_barrier(commandBuffer, spectrogram.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT,
+                            VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                            VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        spectrogram.columns = columns;
+        spectrogram.cleared = true;
+    }
+    else {
+        spectrogram_barrier(commandBuffer, spectrogram.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_SHADER_READ_BIT,
+                            VK_ACCESS_TRANSFER_WRITE_BIT, shaderStages, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    }
+
+    // A row each, the ring may wrap between them
+    VkBufferImageCopy regions[SPECTROGRAM_UPLOAD_ROWS] = {};
+    for (uint r=0; r < rows_count; r++) {
+        spectrogram.newest_row = (spectrogram.newest_row + 1) % SPECTROGRAM_ROWS;
+
+        VkBufferImageCopy &region = regions[r];
+        region.bufferOffset = (slice - spectrogram.row_slices[0]) + (r * spectrogram.width);
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, (int32_t) spectrogram.newest_row, 0};
+        region.imageExtent = {columns, 1, 1};
+    }
+    dev_funct->vkCmdCopyBufferToImage(commandBuffer, spectrogram.staging, spectrogram.image,
+                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, rows_count, regions);
+
+    spectrogram_barrier(commandBuffer, spectrogram.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, shaderStages);
+}
+
+// Timed like the main shader
+shader_setting get_spectrogram_shader() {
+    shader_setting shader = recidia_settings.graphics.main_shader;
+    shader.vertex = (char*) "spectrogram.vert";
+    shader.frag = (char*) "spectrogram.frag";
+    return shader;
+}
+
+void createPipline(shader_setting shader, VkRenderPass render_pass, VkSampleCountFlagBits samples,
+                   VkDescriptorSetLayout descSetLayout, VkPipelineLayout &pipelineLayout, VkPipeline &pipeline) {
+    VkResult err;
+
+    // Graphics pipeline
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+
+    // No vertex data, positions come from the plots buffer
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo;
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 0;
+    vertexInputInfo.pVertexBindingDescriptions = nullptr;
+    vertexInputInfo.vertexAttributeDescriptionCount = 0;
+    vertexInputInfo.pVertexAttributeDescriptions = nullptr;
+    vertexInputInfo.pNext = nullptr;
+    vertexInputInfo.flags = 0;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+
+    // Default shaders
+    if (!shader.vertex) {
+        string shaderName = "default.vert";
+        shader.vertex = new char[shaderName.length()+1];
+        strcpy(shader.vertex, shaderName.c_str());
+    }
+    if (!shader.frag) {
+        string shaderName = "default.frag";
+        shader.frag = new char[shaderName.length()+1];
+        strcpy(shader.frag, shaderName.c_str());
+    }
+    // Shaders
+    VkShaderModule vertShaderModule = createShader(shader.vertex, shaderc_shader_kind::shaderc_glsl_vertex_shader);
+    VkShaderModule fragShaderModule = createShader(shader.frag, shaderc_shader_kind::shaderc_glsl_fragment_shader);
+    if (!vertShaderModule || !fragShaderModule) {
+        if (vertShaderModule)
+            dev_funct->vkDestroyShaderModule(vulkan_dev, vertShaderModule, nullptr);
+        if (fragShaderModule)
+            dev_funct->vkDestroyShaderModule(vulkan_dev, fragShaderModule, nullptr);
+
+        pipeline = VK_NULL_HANDLE;
+        return;
+    }
+
+    VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertShaderStageInfo.module = vertShaderModule;
+    vertShaderStageInfo.pName = "main";
+
+    VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    fragShaderStageInfo.module = fragShaderModule;
+    fragShaderStageInfo.pName = "main";
+
+    VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+
+    // Input Assembly
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+
+    // The viewport and scissor will be set dynamically via vkCmdSetViewport/Scissor.
+    // This way the pipeline does not need to be touched when resizing the window.
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+    pipelineInfo.pViewportState = &viewportState;
+
+    // Rasterizer
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT; // NEEDED to flip y axis
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer.depthBiasEnable = VK_FALSE;
+    pipelineInfo.pRasterizationState = &rasterizer;
+
+    // Multisampling
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = samples;
+    pipelineInfo.pMultisampleState = &multisampling;
+
+    // Depth Stencil
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+
+    // Color Blending
+    VkPipelineColorBlendAttachmentState colorBlendAtt{};
+    colorBlendAtt.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colorBlendAtt.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAtt.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAtt.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAtt.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colorBlendAtt.alphaBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAtt.colorWriteMask = 0xF; // All Colors
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAtt;
+
+    pipelineInfo.pColorBlendState = &colorBlending;
+
+    // Dynamnic States (changes without recreating pipeline)
+    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = sizeof(dynamicStates) / sizeof(VkDynamicState);
+    dynamicState.pDynamicStates = dynamicStates;
+    pipelineInfo.pDynamicState = &dynamicState;
+
+    // Pipeline layout (Allows for uniform values or GPU global variables)
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descSetLayout;
+    
+	// Setup push constants to pass data to shaders
+	VkPushConstantRange push_constant;
+	push_constant.offset = 0;
+	push_constant.size = sizeof(PushConstants);
+	push_constant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	pipelineLayoutInfo.pPushConstantRanges = &push_constant;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+
+
+    err = dev_funct->vkCreatePipelineLayout(vulkan_dev, &pipelineLayoutInfo, nullptr, &pipelineLayout);
+    if (err != VK_SUCCESS)
+        throw std::runtime_error("Failed to create pipeline layout!");
+
+    pipelineInfo.layout = pipelineLayout;
+
+    pipelineInfo.renderPass = render_pass;
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    // Finish up Pipline
+    err = dev_funct->vkCreateGraphicsPipelines(vulkan_dev, pipeline_cache, 1, &pipelineInfo, nullptr, &pipeline);
+    if (err != VK_SUCCESS)
+        printf("Failed to create graphics pipeline: %d", err);
+
+    // Cleanup
+    if (vertShaderModule)
+        dev_funct->vkDestroyShaderModule(vulkan_dev, vertShaderModule, nullptr);
+    if (fragShaderModule)
+        dev_funct->vkDestroyShaderModule(vulkan_dev, fragShaderModule, nullptr);
+}
+
+static float get_linear_color(uint srgb) {
+
+    float srgbF = (float) srgb / 255;
+
+    if (srgbF <= 0.04045)
+        return srgbF/12.92;
+    else
+        return pow((srgbF+0.055) / 1.055, 2.4);
+}
+
+// "power" is published with the plots, see recidia_power_stats
+static PushConstants get_push_constants(shader_setting shader, float power, u_int64_t time) {
+    PushConstants constants{};
+    
+    constants.time = (float) (time % (1000000 * shader.loop_time)) / 1000000;
+    constants.power = power * shader.power;
+
+    return constants;
+}
+
+void draw_background(VkCommandBuffer &commandBuffer, VkPipelineLayout &pipelineLayout, VkPipeline &pipeline,
+                     VkDescriptorSet &descSet, const recidia_plots_history &plots_history, const float color[4],
+                     u_int64_t time) {
+    if (!pipeline) // Shader failed to build
+        return;
+
+    dev_funct->vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    dev_funct->vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+                                       &descSet, 0, nullptr);
+
+    PushConstants constants = get_push_constants(recidia_settings.graphics.back_shader,
+                                                 plots_history.power_stats.back_power, time);
+    constants.draw_mode = DRAW_BACKGROUND;
+    constants.color = {color[0], color[1], color[2], color[3]};
+
+    dev_funct->vkCmdPushConstants(commandBuffer, pipelineLayout, 
+            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &constants);
+
+    dev_funct->vkCmdDraw(commandBuffer, QUAD_VERTICES_COUNT, 1, 0, 0);
+}
+
+void draw_plots(VkCommandBuffer &commandBuffer, VkPipelineLayout &pipelineLayout, VkPipeline &pipeline,
+                VkDescriptorSet &descSet, float *plots_slice[2], const recidia_plots_history &plots_history,
+                const float color[4], float width, float height, float blend, u_int64_t time) {
+    if (!pipeline) // Shader failed to build
+        return;
+
+    // Only the heights are uploaded, the vertex shaders place, scale and blend the plots
+    // Host coherent, the frame's slice is no longer read once its command buffer can be recorded
+    uint plotsCount = min((uint) plots_history.current.size(), (uint) (PLOTS_BUFFER_SIZE / sizeof(float)));
+    memcpy(plots_slice[0], plots_history.current.data(), plotsCount * sizeof(float));
+    memcpy(plots_slice[1], plots_history.previous.data(), plotsCount * sizeof(float));
+
+    dev_funct->vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    dev_funct->vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+                                       &descSet, 0, nullptr);
+
+    PushConstants constants = get_push_constants(recidia_settings.graphics.main_shader,
+                                                 plots_history.power_stats.main_power, time);
+    constants.plots_count = plotsCount;
+    constants.draw_mode = recidia_settings.design.draw_mode;
+
+    constants.color = {color[0], color[1], color[2], color[3]};
+
+    // Pixel to relative
+    float relHeight = 2.0;
+    float relSize = relHeight / width;
+
+    constants.origin = {recidia_settings.design.draw_x, recidia_settings.design.draw_y};
+    constants.plot_width = relSize * (float) recidia_settings.design.plot_width;
+    constants.step = relSize * (float) (recidia_settings.design.plot_width + recidia_settings.design.gap_width);
+    constants.height_scale = relHeight / recidia_settings.data.height_cap;
+    constants.min_height = recidia_settings.design.min_plot_height * relHeight;
+    constants.max_height = recidia_settings.design.draw_height * relHeight;
+    constants.blend = blend;
+    constants.curve_subdivisions = recidia_settings.design.curve_subdivisions;
+
+    // Placed by the vertex shaders, a layout costs nothing on the CPU
+    constants.plots_layout = recidia_settings.design.layout;
+    constants.inner_radius = recidia_settings.design.inner_radius;
+    constants.start_angle = recidia_settings.design.start_angle * (M_PI / 180);
+    constants.aspect = height / width;
+
+    dev_funct->vkCmdPushConstants(commandBuffer, pipelineLayout, 
+            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &constants);
+
+    // An instance per plot, or per pair of plots for a curve's strip of quads
+    // Mirrored draws them all twice
+    uint copies = (constants.plots_layout == LAYOUT_MIRRORED) ? 2 : 1;
+    if (constants.draw_mode == DRAW_CURVE) {
+        if (plotsCount > 1)
+            dev_funct->vkCmdDraw(commandBuffer, QUAD_VERTICES_COUNT * constants.curve_subdivisions,
+                                 (plotsCount - 1) * copies, 0, 0);
+    }
+    else
+        dev_funct->vkCmdDraw(commandBuffer, QUAD_VERTICES_COUNT, plotsCount * copies, 0, 0);
+}
+
+// One quad over the plots' area, the rows are pushed by push_spectrogram_rows()
+void draw_spectrogram(VkCommandBuffer &commandBuffer, VkPipelineLayout &pipelineLayout, VkPipeline &pipeline,
+                      VkDescriptorSet &descSet, const SpectrogramResources &spectrogram,
+                      const recidia_plots_history &plots_history, float width, u_int64_t time) {
+    if (!pipeline || !spectrogram.cleared) // Shader failed to build or no rows yet
+        return;
+
+    dev_funct->vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    dev_funct->vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+                                       &descSet, 0, nullptr);
+
+    PushConstants constants = get_push_constants(recidia_settings.graphics.main_shader,
+                                                 plots_history.power_stats.main_power, time);
+    constants.plots_count = spectrogram.columns;
+    constants.draw_mode = DRAW_SPECTROGRAM;
+    constants.newest_row = spectrogram.newest_row;
+
+    // Pixel to relative
+    float relHeight = 2.0;
+    float relSize = relHeight / width;
+
+    constants.origin = {recidia_settings.design.draw_x, recidia_settings.design.draw_y};
+    constants.step = relSize * (float) (recidia_settings.design.plot_width + recidia_settings.design.gap_width);
+    constants.max_height = recidia_settings.design.draw_height * relHeight;
+
+    dev_funct->vkCmdPushConstants(commandBuffer, pipelineLayout,
+            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &constants);
+
+    dev_funct->vkCmdDraw(commandBuffer, QUAD_VERTICES_COUNT, 1, 0, 0);
+}
+
+void set_linear_color(float color[4], rgba_color srgb) {
+    float alpha = (float) srgb.alpha / 255;
+    color[0] = get_linear_color(srgb.red) * alpha;
+    color[1] = get_linear_color(srgb.green) * alpha;
+    color[2] = get_linear_color(srgb.blue) * alpha;
+    color[3] = alpha;
+}
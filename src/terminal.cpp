@@ -0,0 +1,205 @@
+#include <unistd.h>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <termios.h>
+#include <sys/ioctl.h>
+
+#include <terminal.hpp>
+
+using namespace std;
+
+// Alternate screen, hidden cursor, mouse button reports in SGR encoding
+static const char ENTER_SEQUENCE[] = "\x1b[?1049h\x1b[?25l\x1b[?1000h\x1b[?1006h\x1b[2J";
+static const char LEAVE_SEQUENCE[] = "\x1b[?1006l\x1b[?1000l\x1b[0m\x1b[?25h\x1b[?1049l";
+
+static struct termios saved_termios;
+static bool raw_mode = false;
+
+// Async signal safe, also runs from the signal handlers
+static void restore_terminal() {
+    if (!raw_mode)
+        return;
+    raw_mode = false;
+
+    ssize_t written = write(STDOUT_FILENO, LEAVE_SEQUENCE, sizeof(LEAVE_SEQUENCE) - 1);
+    (void) written;
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved_termios);
+}
+
+static void restore_terminal_on_signal(int signal) {
+    restore_terminal();
+    // Default handling, so the exit status is still the signal's
+    ::signal(signal, SIG_DFL);
+    raise(signal);
+}
+
+// Whole buffer, write() may only take part of it on slow terminals
+static void write_all(const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(STDOUT_FILENO, data, size);
+        if (written < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            return;
+        }
+        data += written;
+        size -= written;
+    }
+}
+
+bool open_raw_terminal(RawTerminal &terminal) {
+    if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO))
+        return false;
+    if (tcgetattr(STDIN_FILENO, &saved_termios) != 0)
+        return false;
+
+    // No echo or line buffering, reads don't wait, Ctrl-C still signals
+    struct termios rawTermios = saved_termios;
+    rawTermios.c_lflag &= ~(ICANON | ECHO);
+    rawTermios.c_iflag &= ~(IXON | ICRNL);
+    rawTermios.c_cc[VMIN] = 0;
+    rawTermios.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &rawTermios) != 0)
+        return false;
+    raw_mode = true;
+
+    atexit(restore_terminal);
+    signal(SIGINT, restore_terminal_on_signal);
+    signal(SIGTERM, restore_terminal_on_signal);
+
+    write_all(ENTER_SEQUENCE, sizeof(ENTER_SEQUENCE) - 1);
+    terminal.cursor_known = false;
+    update_raw_terminal_size(terminal);
+    return true;
+}
+
+void close_raw_terminal(RawTerminal &terminal) {
+    restore_terminal();
+    terminal.frame.clear();
+    terminal.input.clear();
+}
+
+bool update_raw_terminal_size(RawTerminal &terminal) {
+    struct winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0 || !size.ws_col || !size.ws_row)
+        return false;
+    if (size.ws_col == terminal.width && size.ws_row == terminal.height)
+        return false;
+
+    terminal.width = size.ws_col;
+    terminal.height = size.ws_row;
+    // Each cell a 4 byte glyph after a cursor move, with room for color changes and text
+    terminal.frame.reserve((size_t) terminal.width * terminal.height * 32 + 4096);
+    terminal.cursor_known = false;
+    return true;
+}
+
+void begin_raw_frame(RawTerminal &terminal) {
+    terminal.frame.clear();
+    terminal.frame += "\x1b[?2026h";
+}
+
+void clear_raw_frame(RawTerminal &terminal) {
+    terminal.frame += "\x1b[2J";
+    terminal.cursor_known = false;
+}
+
+void set_raw_colors(RawTerminal &terminal, const string &sgr) {
+    terminal.colors = "\x1b[0";
+    if (!sgr.empty()) {
+        terminal.colors += ';';
+        terminal.colors += sgr;
+    }
+    terminal.colors += 'm';
+
+    terminal.frame += terminal.colors;
+    terminal.foreground = nullptr;
+}
+
+void set_raw_foreground(RawTerminal &terminal, const string *sequence) {
+    // Runs of the same color only get one
+    if (sequence == terminal.foreground)
+        return;
+
+    terminal.frame += sequence ? *sequence : terminal.colors;
+    terminal.foreground = sequence;
+}
+
+void draw_raw(RawTerminal &terminal, uint y, uint x, const char *text, uint columns) {
+    if (!terminal.cursor_known || terminal.cursor_y != y || terminal.cursor_x != x) {
+        char move[32];
+        int length = snprintf(move, sizeof(move), "\x1b[%u;%uH", y + 1, x + 1);
+        terminal.frame.append(move, length);
+    }
+    terminal.frame += text;
+
+    // Past the last column the cursor stays put, so it's unknown there
+    terminal.cursor_y = y;
+    terminal.cursor_x = x + columns;
+    terminal.cursor_known = terminal.cursor_x < terminal.width;
+}
+
+void flush_raw_frame(RawTerminal &terminal) {
+    terminal.frame += "\x1b[?2026l";
+    write_all(terminal.frame.data(), terminal.frame.size());
+}
+
+// Mouse reports are "ESC [ < button ; x ; y M", wheel buttons are 64 and 65
+static int parse_escape_sequence(RawTerminal &terminal, size_t &length) {
+    const string &input = terminal.input;
+    length = 1;
+    if (input.size() < 2) // Lone ESC, maybe the rest is still coming
+        return RAW_KEY_NONE;
+    if (input[1] != '[')
+        return 0x1b;
+
+    // Ends at the first final byte
+    size_t end = 2;
+    while (end < input.size() && (input[end] < 0x40 || input[end] > 0x7e))
+        end++;
+    if (end == input.size())
+        return RAW_KEY_NONE;
+    length = end + 1;
+
+    if (input[2] == '<' && (input[end] == 'M' || input[end] == 'm')) {
+        int button = atoi(input.c_str() + 3);
+        if (input[end] == 'M' && button == 64)
+            return RAW_KEY_SCROLL_UP;
+        if (input[end] == 'M' && button == 65)
+            return RAW_KEY_SCROLL_DOWN;
+    }
+    // Anything else like arrow keys isn't a setting
+    return 0;
+}
+
+int read_raw_key(RawTerminal &terminal) {
+    char buffer[256];
+    ssize_t count = read(STDIN_FILENO, buffer, sizeof(buffer));
+    if (count > 0)
+        terminal.input.append(buffer, count);
+
+    while (!terminal.input.empty()) {
+        if (terminal.input[0] != 0x1b) {
+            int key = (unsigned char) terminal.input[0];
+            terminal.input.erase(0, 1);
+            return key;
+        }
+
+        size_t length;
+        int key = parse_escape_sequence(terminal, length);
+        if (key == RAW_KEY_NONE) {
+            // A lone ESC that nothing followed
+            if (count <= 0 && terminal.input.size() == 1) {
+                terminal.input.clear();
+                return 0x1b;
+            }
+            return RAW_KEY_NONE;
+        }
+        terminal.input.erase(0, length);
+        if (key)
+            return key;
+    }
+    return RAW_KEY_NONE;
+}
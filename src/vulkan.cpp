@@ -1,87 +1,29 @@
-#include <fstream>
+#include <cstring>
+#include <cerrno>
 #include <unistd.h>
+#include <sys/inotify.h>
 
 #include <QVulkanFunctions>
 #include <QApplication>
 
-#include <glm/glm.hpp>
-#include <shaderc/shaderc.hpp>
-
 #include <qt_window.hpp>
+#include <render.hpp>
 #include <recidia.h>
 
 using namespace std;
 
-static VulkanWindow *vulkan_window;
-static VkDevice vulkan_dev;
-static QVulkanDeviceFunctions *dev_funct;
-
-VkBuffer back_vertex_buffer;
-VkDeviceMemory back_vertex_buffer_mem;
-VkBuffer main_vertex_buffer;
-VkDeviceMemory main_vertex_buffer_mem;
-VkBuffer main_index_buffer;
-VkDeviceMemory main_index_buffer_mem;
-
-struct Vertex {
-    glm::vec3 pos;
-    glm::vec4 color;
-
-    static VkVertexInputBindingDescription getBindingDescription(int binding) {
-        VkVertexInputBindingDescription bindingDescription{};
-        bindingDescription.binding = binding;
-        bindingDescription.stride = sizeof(Vertex);
-        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-        return bindingDescription;
-    }
-
-    static array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions(int binding) {
-        array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
-        attributeDescriptions[0].binding = binding;
-        attributeDescriptions[0].location = 0;
-        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-        attributeDescriptions[1].binding = binding;
-        attributeDescriptions[1].location = 1;
-        attributeDescriptions[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-        attributeDescriptions[1].offset = offsetof(Vertex, color);
+static_assert(RENDER_MAX_FRAMES == QVulkanWindow::MAX_CONCURRENT_FRAME_COUNT, "See FrameResources");
 
-        return attributeDescriptions;
-    }
-};
-
-struct PushConstants {
-    glm::float32 time;
-    glm::float32 power;
-};
-
-std::vector<Vertex> BAR_VERTICES = {
-    {{-0.0f, -1.0f, 0.0f}, {1.0f, 1.0f, 1.0f, 1.0f}},
-    {{1.0f, -1.0f, 0.0f}, {1.0f, 1.0f, 1.0f, 1.0f}},
-    {{1.0f, 1.0f, 0.0f}, {1.0f, 1.0f, 1.0f, 1.0f}},
-    {{-1.0f, 1.0f, 0.0f}, {1.0f, 1.0f, 1.0f, 1.0f}}
-};
-std::vector<uint16_t> BAR_INDICES = {
-    0, 1, 2, 2, 3, 0
-};
+static VulkanWindow *vulkan_window;
 
-static uint VERTEX_BUFFER_SIZE = sizeof(Vertex) * 4;
-static uint INDEX_BUFFER_SIZE = sizeof(uint32_t) * 6;
-static bool BUFFERS_SIZE_FINALIZED = false;
+// See VulkanRenderer::createQueryPool()
+const uint GPU_TIMESTAMPS_COUNT = 3;
 
 
 QVulkanWindowRenderer *VulkanWindow::createRenderer() {
     VulkanRenderer *renderer = new VulkanRenderer(this);
 
-    // Set "const" buffer sizes
-    if (!BUFFERS_SIZE_FINALIZED) {
-        VERTEX_BUFFER_SIZE *= recidia_settings.data.AUDIO_BUFFER_SIZE.MAX / 2;
-        INDEX_BUFFER_SIZE *= recidia_settings.data.AUDIO_BUFFER_SIZE.MAX / 2;
-
-        BUFFERS_SIZE_FINALIZED = true;
-    }
+    finalize_buffers_size();
 
     return renderer;
 }
@@ -90,241 +32,51 @@ VulkanRenderer::VulkanRenderer(VulkanWindow *window) {
     vulkan_window = window;
 }
 
-VkShaderModule createShader(const string name, shaderc_shader_kind shader_kind) {
-    string homeDir = getenv("HOME");
-    string shaderFileLocations[] = {"shaders/",
-                                    "../shaders/",
-                                    homeDir + "/.config/recidia/shaders/",
-                                    "/etc/recidia/shaders/"};
-    // Read shader file
-    ifstream file;
-    for (uint i=0; i < 4; i++) {
-        file.open(shaderFileLocations[i] + name);
-        if (file.is_open())
-            break;
-    }
-    if (!file.is_open())
-        throw std::runtime_error("Failed to find shader file!");
-
-    std::string shaderText( (std::istreambuf_iterator<char>(file) ),
-                          (std::istreambuf_iterator<char>()    ) );
-    file.close();
-
-    shaderc::Compiler compiler;
-    shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(shaderText, shader_kind, "");
-    vector<uint32_t> spvCode;
-    spvCode.assign(result.cbegin(), result.cend());
-
-    VkShaderModuleCreateInfo shaderInfo;
-    shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    shaderInfo.codeSize = sizeof(uint32_t) * spvCode.size();
-    shaderInfo.pCode = (const uint32_t*) spvCode.data();
-    shaderInfo.pNext = nullptr; // WILL SEGV WITHOUT
-    shaderInfo.flags = 0;
-
-    VkShaderModule shaderModule;
-    VkResult err = dev_funct->vkCreateShaderModule(vulkan_dev, &shaderInfo, nullptr, &shaderModule);
-    if (err != VK_SUCCESS) {
-        printf("Failed to create shader module: %d\n", err);
-        return VK_NULL_HANDLE;
-    }
-
-    return shaderModule;
-}
-
-void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
-        VkBufferCreateInfo bufferInfo{};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = size;
-        bufferInfo.usage = usage;
-        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-        if (dev_funct->vkCreateBuffer(vulkan_dev, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create buffer!");
-        }
-
-        VkMemoryRequirements memRequirements;
-        dev_funct->vkGetBufferMemoryRequirements(vulkan_dev, buffer, &memRequirements);
-
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = vulkan_window->hostVisibleMemoryIndex();
-
-        if (dev_funct->vkAllocateMemory(vulkan_dev, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate buffer memory!");
-        }
-
-        dev_funct->vkBindBufferMemory(vulkan_dev, buffer, bufferMemory, 0);
-    }
-
-static void createPipline(shader_setting shader, VkPipelineLayout &pipelineLayout, VkPipeline &pipeline, int binding) {
-    VkResult err;
-
-    // Graphics pipeline
-    VkGraphicsPipelineCreateInfo pipelineInfo{};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-
-    // Vertex data info
-    auto bindingDescription = Vertex::getBindingDescription(binding);
-    auto attributeDescriptions = Vertex::getAttributeDescriptions(binding);
-
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo;
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-    vertexInputInfo.pNext = nullptr;
-    vertexInputInfo.flags = 0;
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-
-    // Default shaders
-    if (!shader.vertex) {
-        string shaderName = "default.vert";
-        shader.vertex = new char[shaderName.length()+1];
-        strcpy(shader.vertex, shaderName.c_str());
-    }
-    if (!shader.frag) {
-        string shaderName = "default.frag";
-        shader.frag = new char[shaderName.length()+1];
-        strcpy(shader.frag, shaderName.c_str());
-    }
-    // Shaders
-    VkShaderModule vertShaderModule = createShader(shader.vertex, shaderc_shader_kind::shaderc_glsl_vertex_shader);
-    VkShaderModule fragShaderModule = createShader(shader.frag, shaderc_shader_kind::shaderc_glsl_fragment_shader);
-
-    VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertShaderStageInfo.module = vertShaderModule;
-    vertShaderStageInfo.pName = "main";
-
-    VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragShaderStageInfo.module = fragShaderModule;
-    fragShaderStageInfo.pName = "main";
-
-    VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
-
-    pipelineInfo.stageCount = 2;
-    pipelineInfo.pStages = shaderStages;
-
-    // Input Assembly
-    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    inputAssembly.primitiveRestartEnable = VK_FALSE;
-    pipelineInfo.pInputAssemblyState = &inputAssembly;
-
-    // The viewport and scissor will be set dynamically via vkCmdSetViewport/Scissor.
-    // This way the pipeline does not need to be touched when resizing the window.
-    VkPipelineViewportStateCreateInfo viewportState{};
-    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportState.viewportCount = 1;
-    viewportState.scissorCount = 1;
-    pipelineInfo.pViewportState = &viewportState;
-
-    // Rasterizer
-    VkPipelineRasterizationStateCreateInfo rasterizer{};
-    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizer.depthClampEnable = VK_FALSE;
-    rasterizer.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT; // NEEDED to flip y axis
-    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    rasterizer.depthBiasEnable = VK_FALSE;
-    pipelineInfo.pRasterizationState = &rasterizer;
-
-    // Multisampling
-    VkPipelineMultisampleStateCreateInfo multisampling{};
-    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampling.rasterizationSamples = vulkan_window->sampleCountFlagBits();
-    pipelineInfo.pMultisampleState = &multisampling;
-
-    // Depth Stencil
-    VkPipelineDepthStencilStateCreateInfo depthStencil{};
-    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depthStencil.depthTestEnable = VK_TRUE;
-    depthStencil.depthWriteEnable = VK_TRUE;
-    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-    pipelineInfo.pDepthStencilState = &depthStencil;
-
-    // Color Blending
-    VkPipelineColorBlendAttachmentState colorBlendAtt{};
-    colorBlendAtt.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-    colorBlendAtt.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-    colorBlendAtt.colorBlendOp = VK_BLEND_OP_ADD;
-    colorBlendAtt.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    colorBlendAtt.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    colorBlendAtt.alphaBlendOp = VK_BLEND_OP_ADD;
-    colorBlendAtt.colorWriteMask = 0xF; // All Colors
-
-    VkPipelineColorBlendStateCreateInfo colorBlending{};
-    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlending.logicOpEnable = VK_FALSE;
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAtt;
-
-    pipelineInfo.pColorBlendState = &colorBlending;
-
-    // Dynamnic States (changes without recreating pipeline)
-    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-    VkPipelineDynamicStateCreateInfo dynamicState{};
-    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamicState.dynamicStateCount = sizeof(dynamicStates) / sizeof(VkDynamicState);
-    dynamicState.pDynamicStates = dynamicStates;
-    pipelineInfo.pDynamicState = &dynamicState;
-
-    // Pipeline layout (Allows for uniform values or GPU global variables)
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0;
-    
-	// Setup push constants to pass data to shaders
-	VkPushConstantRange push_constant;
-	push_constant.offset = 0;
-	push_constant.size = sizeof(PushConstants);
-	push_constant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-
-	pipelineLayoutInfo.pPushConstantRanges = &push_constant;
-	pipelineLayoutInfo.pushConstantRangeCount = 1;
-
-
-    err = dev_funct->vkCreatePipelineLayout(vulkan_dev, &pipelineLayoutInfo, nullptr, &pipelineLayout);
-    if (err != VK_SUCCESS)
-        qFatal("Failed to create pipeline layout: %d", err);
-
-    pipelineInfo.layout = pipelineLayout;
-
-    pipelineInfo.renderPass = vulkan_window->defaultRenderPass();
-    pipelineInfo.subpass = 0;
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-    // Finish up Pipline
-    err = dev_funct->vkCreateGraphicsPipelines(vulkan_dev, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
-    if (err != VK_SUCCESS)
-        printf("Failed to create graphics pipeline: %d", err);
-
-    // Cleanup
-    if (vertShaderModule)
-        dev_funct->vkDestroyShaderModule(vulkan_dev, vertShaderModule, nullptr);
-    if (fragShaderModule)
-        dev_funct->vkDestroyShaderModule(vulkan_dev, fragShaderModule, nullptr);
-}
-
 void VulkanRenderer::initResources() {
-    vulkan_dev = vulkan_window->device();
-    dev_funct = vulkan_window->vulkanInstance()->deviceFunctions(vulkan_dev);
-
-    createBuffer(VERTEX_BUFFER_SIZE, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, back_vertex_buffer, back_vertex_buffer_mem);
-    createBuffer(VERTEX_BUFFER_SIZE, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, main_vertex_buffer, main_vertex_buffer_mem);
-    createBuffer(INDEX_BUFFER_SIZE, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, main_index_buffer, main_index_buffer_mem);
-
-    createPipline(recidia_settings.graphics.back_shader, back_pipelineLayout, back_pipeline, 0);
-    createPipline(recidia_settings.graphics.main_shader, main_pipelineLayout, main_pipeline, 1);
+    PFN_vkGetDeviceProcAddr getDeviceProcAddr =
+        (PFN_vkGetDeviceProcAddr) vulkan_window->vulkanInstance()->getInstanceProcAddr("vkGetDeviceProcAddr");
+    if (!init_render_device(vulkan_window->device(), getDeviceProcAddr))
+        qFatal("Failed to load the device functions");
+
+    create_frame_resources(m_frames, vulkan_window->concurrentFrameCount(),
+                           vulkan_window->physicalDeviceProperties()->limits, vulkan_window->hostVisibleMemoryIndex());
+
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vulkan_window->vulkanInstance()->functions()->vkGetPhysicalDeviceMemoryProperties(vulkan_window->physicalDevice(),
+                                                                                      &memoryProperties);
+    create_spectrogram(m_spectrogram, m_frames, vulkan_window->concurrentFrameCount(),
+                       vulkan_window->physicalDeviceProperties()->limits, memoryProperties);
+
+    this->createQueryPool();
+
+    create_pipeline_cache(*vulkan_window->physicalDeviceProperties());
+
+    createPipline(recidia_settings.graphics.back_shader, vulkan_window->defaultRenderPass(),
+                  vulkan_window->sampleCountFlagBits(), m_frames.desc_set_layout, back_pipelineLayout, back_pipeline);
+    createPipline(recidia_settings.graphics.main_shader, vulkan_window->defaultRenderPass(),
+                  vulkan_window->sampleCountFlagBits(), m_frames.desc_set_layout, main_pipelineLayout, main_pipeline);
+    createPipline(get_spectrogram_shader(), vulkan_window->defaultRenderPass(), vulkan_window->sampleCountFlagBits(),
+                  m_frames.desc_set_layout, spectrogram_pipelineLayout, spectrogram_pipeline);
+
+    this->watchShaders();
+
+    frame_timer = new QTimer();
+    frame_timer->setTimerType(Qt::PreciseTimer);
+    frame_timer->setSingleShot(true);
+    QObject::connect(frame_timer, &QTimer::timeout, [this]() {
+        // Fired a whole ms or more early, wait for the rest in the event loop
+        u_int64_t now = utime_now();
+        if (next_frame_time >= now + 1000)
+            frame_timer->start((next_frame_time - now) / 1000);
+        else if (this->isFrameDue())
+            vulkan_window->requestUpdate();
+        else
+            this->scheduleNextFrame(now);
+    });
+    next_frame_time = utime_now();
+
+    main_animated = is_animated_shader(recidia_settings.graphics.main_shader);
+    back_animated = is_animated_shader(recidia_settings.graphics.back_shader);
 }
 
 void VulkanRenderer::initSwapChainResources() {
@@ -336,19 +88,31 @@ void VulkanRenderer::releaseSwapChainResources() {
 }
 
 void VulkanRenderer::releaseResources() {
-    if (main_vertex_buffer) {
-        dev_funct->vkDestroyBuffer(vulkan_dev, main_vertex_buffer, nullptr);
-        dev_funct->vkFreeMemory(vulkan_dev, main_vertex_buffer_mem, nullptr);
+    if (m_queryPool) {
+        dev_funct->vkDestroyQueryPool(vulkan_dev, m_queryPool, nullptr);
+        m_queryPool = VK_NULL_HANDLE;
     }
-    if (back_vertex_buffer) {
-        dev_funct->vkDestroyBuffer(vulkan_dev, back_vertex_buffer, nullptr);
-        dev_funct->vkFreeMemory(vulkan_dev, back_vertex_buffer_mem, nullptr);
-    }
-    if (main_index_buffer) {
-        dev_funct->vkDestroyBuffer(vulkan_dev, main_index_buffer, nullptr);
-        dev_funct->vkFreeMemory(vulkan_dev, main_index_buffer_mem, nullptr);
+    for (bool &written : m_queriesWritten)
+        written = false;
+
+    delete frame_timer;
+    frame_timer = nullptr;
+
+    delete shader_notifier;
+    shader_notifier = nullptr;
+    if (inotify_fd >= 0) {
+        close(inotify_fd);
+        inotify_fd = -1;
     }
 
+    // The device is idle here
+    if (pipelines_worker.joinable())
+        this->finishPipelinesBuild();
+    this->destroyRetiredPipelines(true);
+    pending_shaders = 0;
+
+    release_pipeline_cache();
+
     if (main_pipeline) {
         dev_funct->vkDestroyPipeline(vulkan_dev, main_pipeline, nullptr);
         main_pipeline = VK_NULL_HANDLE;
@@ -369,193 +133,50 @@ void VulkanRenderer::releaseResources() {
         back_pipelineLayout = VK_NULL_HANDLE;
     }
 
-    if (m_descSetLayout) {
-        dev_funct->vkDestroyDescriptorSetLayout(vulkan_dev, m_descSetLayout, nullptr);
-        m_descSetLayout = VK_NULL_HANDLE;
-    }
-
-    if (m_descPool) {
-        dev_funct->vkDestroyDescriptorPool(vulkan_dev, m_descPool, nullptr);
-        m_descPool = VK_NULL_HANDLE;
-    }
-
-    if (m_buf) {
-        dev_funct->vkDestroyBuffer(vulkan_dev, m_buf, nullptr);
-        m_buf = VK_NULL_HANDLE;
-    }
-
-    if (m_bufMem) {
-        dev_funct->vkFreeMemory(vulkan_dev, m_bufMem, nullptr);
-        m_bufMem = VK_NULL_HANDLE;
-    }
-}
-
-float get_linear_color(uint srgb) {
-
-    float srgbF = (float) srgb / 255;
-
-    if (srgbF <= 0.04045)
-        return srgbF/12.92;
-    else
-        return pow((srgbF+0.055) / 1.055, 2.4);
-}
-
-void create_plots() {
-    // Create bars
-    float alpha = (float) recidia_settings.design.main_color.alpha / 255;
-    float red = get_linear_color(recidia_settings.design.main_color.red) * alpha;
-    float green = get_linear_color(recidia_settings.design.main_color.green) * alpha;
-    float blue = get_linear_color(recidia_settings.design.main_color.blue) * alpha;
-
-    // Finalize plots height
-    float finalPlots[recidia_data.plots_count];
-
-    float relHeight = 2.0;
-    for (uint i=0; i < recidia_data.plots_count; i++ ) {
-
-        // Scale plots
-        finalPlots[i] = (recidia_data.plots[i] / recidia_settings.data.height_cap) * relHeight;
-        if (finalPlots[i] > recidia_settings.design.draw_height * relHeight) {
-            finalPlots[i] = recidia_settings.design.draw_height * relHeight;
-        }
-        else if (finalPlots[i] < recidia_settings.design.min_plot_height * relHeight)
-            finalPlots[i] = recidia_settings.design.min_plot_height * relHeight;
-    }
-
-    vector<Vertex> plotsVertexes;
-    vector<uint32_t> plotsIndexes;
-
-    float relSize = relHeight / (float) vulkan_window->width(); // Pixel to relative
-
-    float plotSize = relSize * (float) recidia_settings.design.plot_width;
-    float stepSize = relSize * (float) (recidia_settings.design.plot_width + recidia_settings.design.gap_width);
-
-    float xPlace = recidia_settings.design.draw_x;
-    float xPos, yPos;
-    for(uint i=0; i < recidia_data.plots_count; i++) {
-
-        for(uint j=0; j < BAR_VERTICES.size(); j++) {
-            auto vertex = BAR_VERTICES[j];
-
-            xPos = xPlace;
-            yPos = recidia_settings.design.draw_y;
-
-            if (j == 1 || j == 2) {
-                xPos += plotSize;
-            }
-            if (j > 1) {
-                if (j == 2 && i < recidia_data.plots_count-1 && recidia_settings.design.draw_mode == 1)
-                    yPos += finalPlots[i+1];
-                else
-                    yPos += finalPlots[i];
-            }
-
-            vertex.pos = {xPos, -yPos, vertex.pos[2]};
-            vertex.color = {red, green, blue, alpha};
-            plotsVertexes.push_back(vertex);
-        }
-        xPlace += stepSize;
-
-        for(uint j=0; j < BAR_INDICES.size(); j++) {
-            auto index = BAR_INDICES[j];
-            index += i*4;
-
-            plotsIndexes.push_back(index);
-        }
+    if (spectrogram_pipeline) {
+        dev_funct->vkDestroyPipeline(vulkan_dev, spectrogram_pipeline, nullptr);
+        spectrogram_pipeline = VK_NULL_HANDLE;
     }
 
-    // Copy vertices data to mem
-    void* data;
-    dev_funct->vkMapMemory(vulkan_dev, main_vertex_buffer_mem, 0, VERTEX_BUFFER_SIZE, 0, &data);
-        memcpy(data, plotsVertexes.data(), plotsVertexes.size() * sizeof(plotsVertexes.data()[0]));
-    dev_funct->vkUnmapMemory(vulkan_dev, main_vertex_buffer_mem);
-    // Index 
-    dev_funct->vkMapMemory(vulkan_dev, main_index_buffer_mem, 0, INDEX_BUFFER_SIZE, 0, &data);
-        memcpy(data, plotsIndexes.data(), plotsIndexes.size() * sizeof(plotsIndexes.data()[0]));
-    dev_funct->vkUnmapMemory(vulkan_dev, main_index_buffer_mem);
-}
-
-static PushConstants get_push_constants(shader_setting shader) {
-    PushConstants constants;
-    
-    constants.time = (float) (utime_now() % (1000000 * shader.loop_time)) / 1000000;
-    
-    constants.power = 0.0;
-    // Rounded up plots count
-    uint plotsPowerCount = 0.5 + (recidia_data.plots_count * (shader.power_mod_range[1] - shader.power_mod_range[0]));
-    uint plotPowerStart = (recidia_data.plots_count - 1) * shader.power_mod_range[0];
-    for(uint i=plotPowerStart; i < (plotsPowerCount + plotPowerStart) && i < recidia_data.plots_count; i++) {
-
-        float powerPush = recidia_data.plots[i] / recidia_settings.data.height_cap;
-        if (powerPush < 1.0) {
-            constants.power += powerPush / plotsPowerCount;
-        }
-        else {
-            constants.power += 1.0 / plotsPowerCount;
-        }
+    if (spectrogram_pipelineLayout) {
+        dev_funct->vkDestroyPipelineLayout(vulkan_dev, spectrogram_pipelineLayout, nullptr);
+        spectrogram_pipelineLayout = VK_NULL_HANDLE;
     }
-    constants.power *= shader.power;
 
-    return constants;
+    release_spectrogram(m_spectrogram);
+    release_frame_resources(m_frames);
 }
 
-static void draw_background(VkCommandBuffer &commandBuffer, VkPipelineLayout &pipelineLayout, VkPipeline &pipeline) {
-
-    // Background Color
-    float alpha = (float) recidia_settings.design.back_color.alpha / 255;
-    float red = get_linear_color(recidia_settings.design.back_color.red) * alpha;
-    float green = get_linear_color(recidia_settings.design.back_color.green) * alpha;
-    float blue = get_linear_color(recidia_settings.design.back_color.blue) * alpha;
-
-    const int verticesCount = 6;
-    Vertex backVerticies[verticesCount] = {
-        {{-1.0f, -1.0f, 0.0f}, {red, green, blue, alpha}},
-        {{-1.0f, 1.0f, 0.0f}, {red, green, blue, alpha}},
-        {{1.0f, -1.0f, 0.0f}, {red, green, blue, alpha}},
-
-        {{-1.0f, 1.0f, 0.0f}, {red, green, blue, alpha}},
-        {{1.0f, 1.0f, 0.0f}, {red, green, blue, alpha}},
-        {{1.0f, -1.0f, 0.0f}, {red, green, blue, alpha}},
-    };
-
-    void* data;
-    dev_funct->vkMapMemory(vulkan_dev, back_vertex_buffer_mem, 0, VERTEX_BUFFER_SIZE, 0, &data);
-        memcpy(data, backVerticies, sizeof(backVerticies[0]) * verticesCount);
-    dev_funct->vkUnmapMemory(vulkan_dev, back_vertex_buffer_mem);
-
-    dev_funct->vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+void VulkanRenderer::updateRenderState() {
+    if (render_state.cached && render_state.colors_generation == recidia_settings.design.colors_generation)
+        return;
 
-    PushConstants constants = get_push_constants(recidia_settings.graphics.back_shader);
-    dev_funct->vkCmdPushConstants(commandBuffer, pipelineLayout, 
-            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &constants);
-
-    dev_funct->vkCmdDraw(commandBuffer, verticesCount, 1, 0, 0);
-}
-
-static void draw_plots(VkCommandBuffer &commandBuffer, VkPipelineLayout &pipelineLayout, VkPipeline &pipeline) {
-    create_plots();
-
-    dev_funct->vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-
-    PushConstants constants = get_push_constants(recidia_settings.graphics.main_shader);
-    dev_funct->vkCmdPushConstants(commandBuffer, pipelineLayout, 
-            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &constants);
-
-    uint32_t indices_count = recidia_data.plots_count * BAR_INDICES.size();
-    dev_funct->vkCmdDrawIndexed(commandBuffer, indices_count, 1, 0, 0, 0);
+    render_state.colors_generation = recidia_settings.design.colors_generation;
+    set_linear_color(render_state.main_color, recidia_settings.design.main_color);
+    set_linear_color(render_state.back_color, recidia_settings.design.back_color);
+    render_state.cached = true;
 }
 
 void VulkanRenderer::startNextFrame() {
     VkCommandBuffer commandBuffer = vulkan_window->currentCommandBuffer();
 
-    if (vulkan_window->shader_setting_change) {
-        this->recreatePipline();
-        vulkan_window->shader_setting_change = 0;
+    // Pipelines swap only between frames, the old ones keep drawing while building
+    pending_shaders |= vulkan_window->shader_setting_change;
+    vulkan_window->shader_setting_change = 0;
+    if (pipelines_worker.joinable() && pipelines_built)
+        this->finishPipelinesBuild();
+    if (!pipelines_worker.joinable() && pending_shaders) {
+        this->startPipelinesBuild(pending_shaders);
+        pending_shaders = 0;
     }
+    this->destroyRetiredPipelines(false);
+
+    this->updateRenderState();
 
     recidia_data.width = vulkan_window->width() * recidia_settings.design.draw_width;
     recidia_data.height = vulkan_window->height() * recidia_settings.design.draw_height;
-    recidia_data.plots_count = (recidia_data.width / (recidia_settings.design.plot_width + recidia_settings.design.gap_width)) + 1;
+    uint plotsCount = (recidia_data.width / (recidia_settings.design.plot_width + recidia_settings.design.gap_width)) + 1;
+    __atomic_store_n(&recidia_data.requested_plots_count, plotsCount, __ATOMIC_RELAXED);
 
     VkClearColorValue clearColor = {{0, 0, 0, 0}};
     VkClearDepthStencilValue clearDS = { 1, 0 };
@@ -590,57 +211,306 @@ void VulkanRenderer::startNextFrame() {
     rpBeginInfo.clearValueCount = vulkan_window->sampleCountFlagBits() > VK_SAMPLE_COUNT_1_BIT ? 3 : 2;
     rpBeginInfo.pClearValues = clearValues;
 
-    // Bind buffers
-    VkDeviceSize vbOffset[] = {0};
-    dev_funct->vkCmdBindVertexBuffers(commandBuffer, 0, 1, &back_vertex_buffer, vbOffset);
-    dev_funct->vkCmdBindVertexBuffers(commandBuffer, 1, 1, &main_vertex_buffer, vbOffset);
-    dev_funct->vkCmdBindIndexBuffer(commandBuffer, main_index_buffer, 0, VK_INDEX_TYPE_UINT32);
+    // This frame's plots slice
+    const int frame = vulkan_window->currentFrame();
+
+    // What this frame shows, see isFrameDue()
+    // The spectrogram gets a row per published plots, also the ones published since the last frame
+    if (update_plots_history(plots_history)) {
+        uint plotsCount = plots_history.current.size();
+        push_spectrogram_rows(commandBuffer, m_spectrogram, frame, plots_history.rows.data(),
+                              plotsCount ? plots_history.rows.size() / plotsCount : 0, plotsCount);
+    }
+    memcpy(m_frames.audio_slices[frame], &plots_history.power_stats, sizeof(recidia_power_stats));
+    recidia_data.drawn_plots_count = plots_history.current.size();
+    drawn_width = vulkan_window->width();
+    drawn_height = vulkan_window->height();
+    drawn_settings.resize(sizeof(recidia_settings));
+    memcpy(drawn_settings.data(), &recidia_settings, sizeof(recidia_settings));
+
+    // GPU time of each pass, read back when this frame slot comes around again
+    const uint firstQuery = frame * GPU_TIMESTAMPS_COUNT;
+    if (m_queryPool) {
+        this->readGpuTimes(frame);
+        dev_funct->vkCmdResetQueryPool(commandBuffer, m_queryPool, firstQuery, GPU_TIMESTAMPS_COUNT);
+        dev_funct->vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, firstQuery);
+    }
 
     // DRAW FINALLY
+    u_int64_t drawTime = utime_now();
     dev_funct->vkCmdBeginRenderPass(commandBuffer, &rpBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-    draw_background(commandBuffer, back_pipelineLayout, back_pipeline);
-    draw_plots(commandBuffer, main_pipelineLayout, main_pipeline);
+    draw_background(commandBuffer, back_pipelineLayout, back_pipeline, m_frames.desc_sets[frame], plots_history,
+                    render_state.back_color, drawTime);
+    if (m_queryPool)
+        dev_funct->vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, firstQuery + 1);
+    if (recidia_settings.design.draw_mode == DRAW_SPECTROGRAM)
+        draw_spectrogram(commandBuffer, spectrogram_pipelineLayout, spectrogram_pipeline, m_frames.desc_sets[frame],
+                         m_spectrogram, plots_history, vulkan_window->width(), drawTime);
+    else
+        draw_plots(commandBuffer, main_pipelineLayout, main_pipeline, m_frames.desc_sets[frame],
+                   m_frames.plots_slices[frame], plots_history, render_state.main_color, vulkan_window->width(),
+                   vulkan_window->height(), get_plots_blend(plots_history, drawTime), drawTime);
+    if (m_queryPool) {
+        dev_funct->vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, firstQuery + 2);
+        m_queriesWritten[frame] = true;
+    }
     dev_funct->vkCmdEndRenderPass(commandBuffer);
 
     vulkan_window->frameReady();
-    recidia_data.latency = (float) (utime_now() - recidia_data.start_time) / 1000;
+    frame_count++;
+
+    u_int64_t now = utime_now();
+    recidia_data.latency = (float) (now - recidia_data.start_time) / 1000;
+    recidia_data.frame_time = now - last_frame_time;
+    last_frame_time = now;
+
+    this->scheduleNextFrame(now);
+}
 
-    // Sleep for fps cap
-    // double frameTime = 0;
-    // double sleepTime = (1000 / (double) recidia_settings.design.fps_cap) * 1000;
-    // while (sleepTime > frameTime) {
-    //     QApplication::processEvents(QEventLoop::AllEvents, 1);
-    //     usleep(100);
+// FPS cap by deadlines on an absolute clock, the timer sleeps in the event loop instead of busy waiting
+// Rendering is still throttled by the presentation rate, QVulkanWindow always presents with FIFO
+void VulkanRenderer::scheduleNextFrame(u_int64_t now) {
+    u_int64_t interval = 1000000 / recidia_settings.design.fps_cap;
 
-    //     frameTime = utime_now() - last_frame_time;
-    // }
-    recidia_data.frame_time = utime_now() - last_frame_time;
-    last_frame_time = utime_now();
+    next_frame_time += interval;
+    // Fell behind, start over from now instead of rushing frames to catch up
+    if (next_frame_time < now)
+        next_frame_time = now;
 
-    vulkan_window->requestUpdate(); // render continuously, throttled by the presentation rate
+    // Nearest whole ms, the deadlines are absolute so early frames don't raise the average rate
+    frame_timer->start((next_frame_time - now + 500) / 1000);
 }
 
-void VulkanRenderer::recreatePipline() {
-    dev_funct->vkDeviceWaitIdle(vulkan_dev);
-    this->releaseSwapChainResources();
+// A frame is only drawn when it would look different from the last one
+bool VulkanRenderer::isFrameDue() {
+    // New plots, unless they repeat the drawn ones, the spectrogram scrolls a row for every plots
+    if (__atomic_load_n(&recidia_data.plots_sequence, __ATOMIC_ACQUIRE) != plots_history.sequence) {
+        if (recidia_settings.design.draw_mode == DRAW_SPECTROGRAM)
+            return true;
+        if (__atomic_load_n(&recidia_data.plots_changed_sequence, __ATOMIC_ACQUIRE) > plots_history.sequence)
+            return true;
+    }
+    // Still blending to the current plots
+    if (plots_history.changing && get_plots_blend(plots_history, utime_now()) < 1.0)
+        return true;
+    if (main_animated || back_animated)
+        return true;
+    // Shaders being swapped or retired
+    if (vulkan_window->shader_setting_change || pending_shaders || pipelines_worker.joinable()
+        || !retired_pipelines.empty())
+        return true;
+    if ((uint) vulkan_window->width() != drawn_width || (uint) vulkan_window->height() != drawn_height)
+        return true;
+
+    return drawn_settings.size() != sizeof(recidia_settings)
+           || memcmp(drawn_settings.data(), &recidia_settings, sizeof(recidia_settings)) != 0;
+}
 
-    if (vulkan_window->shader_setting_change == 1) {
-        dev_funct->vkDestroyPipeline(vulkan_dev, main_pipeline, nullptr);
-        main_pipeline = VK_NULL_HANDLE;
-    
-        dev_funct->vkDestroyPipelineLayout(vulkan_dev, main_pipelineLayout, nullptr);
-        main_pipelineLayout = VK_NULL_HANDLE;
+// Timestamps before the background, after the background and after the plots, per frame slot
+void VulkanRenderer::createQueryPool() {
+    QVulkanFunctions *funct = vulkan_window->vulkanInstance()->functions();
+    uint32_t familiesCount = 0;
+    funct->vkGetPhysicalDeviceQueueFamilyProperties(vulkan_window->physicalDevice(), &familiesCount, nullptr);
+    vector<VkQueueFamilyProperties> families(familiesCount);
+    funct->vkGetPhysicalDeviceQueueFamilyProperties(vulkan_window->physicalDevice(), &familiesCount, families.data());
+
+    uint32_t validBits = families[vulkan_window->graphicsQueueFamilyIndex()].timestampValidBits;
+    m_timestampPeriod = vulkan_window->physicalDeviceProperties()->limits.timestampPeriod;
+    if (!validBits || m_timestampPeriod <= 0.0) {
+        printf("GPU timestamps not supported\n");
+        return;
+    }
+    m_timestampMask = (validBits >= 64) ? ~0ULL : ((1ULL << validBits) - 1);
 
-        createPipline(recidia_settings.graphics.main_shader, main_pipelineLayout, main_pipeline, 1);
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = GPU_TIMESTAMPS_COUNT * vulkan_window->concurrentFrameCount();
+
+    VkResult err = dev_funct->vkCreateQueryPool(vulkan_dev, &queryPoolInfo, nullptr, &m_queryPool);
+    if (err != VK_SUCCESS) {
+        printf("Failed to create query pool: %d\n", err);
+        m_queryPool = VK_NULL_HANDLE;
     }
-    else if (vulkan_window->shader_setting_change == 2) {
-        dev_funct->vkDestroyPipeline(vulkan_dev, back_pipeline, nullptr);
-        back_pipeline = VK_NULL_HANDLE;
+}
 
-        dev_funct->vkDestroyPipelineLayout(vulkan_dev, back_pipelineLayout, nullptr);
-        back_pipelineLayout = VK_NULL_HANDLE;
-    
-        createPipline(recidia_settings.graphics.back_shader, back_pipelineLayout, back_pipeline, 0);
+// The frame slot's last frame is done, so this never waits
+void VulkanRenderer::readGpuTimes(int frame) {
+    if (!m_queriesWritten[frame])
+        return;
+
+    uint64_t timestamps[GPU_TIMESTAMPS_COUNT];
+    VkResult err = dev_funct->vkGetQueryPoolResults(vulkan_dev, m_queryPool, frame * GPU_TIMESTAMPS_COUNT,
+                                                    GPU_TIMESTAMPS_COUNT, sizeof(timestamps), timestamps,
+                                                    sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (err != VK_SUCCESS)
+        return;
+
+    // ns to ms
+    float backTime = ((timestamps[1] - timestamps[0]) & m_timestampMask) * m_timestampPeriod / 1000000;
+    float mainTime = ((timestamps[2] - timestamps[1]) & m_timestampMask) * m_timestampPeriod / 1000000;
+
+    // Rolling average
+    const float SMOOTHING = 0.05;
+    recidia_data.gpu_back_time += (backTime - recidia_data.gpu_back_time) * SMOOTHING;
+    recidia_data.gpu_main_time += (mainTime - recidia_data.gpu_main_time) * SMOOTHING;
+}
+
+// Rebuild the pipelines when their shader files change on disk
+void VulkanRenderer::watchShaders() {
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        printf("Failed to watch shaders: %s\n", strerror(errno));
+        return;
+    }
+
+    // Editors often write a new file then rename it over the old one
+    for (const string &location : get_shader_locations())
+        inotify_add_watch(inotify_fd, location.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+
+    shader_notifier = new QSocketNotifier(inotify_fd, QSocketNotifier::Read);
+    QObject::connect(shader_notifier, &QSocketNotifier::activated, [this]() {
+        this->readShaderEvents();
+    });
+}
+
+static bool is_shader_file(const string &file_name, const char *shader_name, const char *default_name) {
+    return file_name == (shader_name ? shader_name : default_name);
+}
+
+void VulkanRenderer::readShaderEvents() {
+    alignas(struct inotify_event) char events[4096];
+    const shader_setting &mainShader = recidia_settings.graphics.main_shader;
+    const shader_setting &backShader = recidia_settings.graphics.back_shader;
+
+    ssize_t size;
+    while ((size = read(inotify_fd, events, sizeof(events))) > 0) {
+        for (char *pos = events; pos < events + size;) {
+            struct inotify_event *event = (struct inotify_event*) pos;
+            pos += sizeof(struct inotify_event) + event->len;
+            if (!event->len)
+                continue;
+
+            string fileName = event->name;
+            // Included by every shader
+            if (fileName.size() > 5 && fileName.compare(fileName.size() - 5, 5, ".glsl") == 0) {
+                vulkan_window->shader_setting_change |= 1 | 2 | 4;
+                continue;
+            }
+            if (fileName == "spectrogram.vert" || fileName == "spectrogram.frag")
+                vulkan_window->shader_setting_change |= 4;
+            if (is_shader_file(fileName, mainShader.vertex, "default.vert")
+                || is_shader_file(fileName, mainShader.frag, "default.frag"))
+                vulkan_window->shader_setting_change |= 1;
+            if (is_shader_file(fileName, backShader.vertex, "default.vert")
+                || is_shader_file(fileName, backShader.frag, "default.frag"))
+                vulkan_window->shader_setting_change |= 2;
+        }
+    }
+}
+
+void VulkanRenderer::startPipelinesBuild(int shaders) {
+    // Copies, the settings may change while building
+    const shader_setting &mainShader = recidia_settings.graphics.main_shader;
+    const shader_setting &backShader = recidia_settings.graphics.back_shader;
+    pipelines_build = PipelinesBuild();
+    pipelines_build.shaders = shaders;
+    pipelines_build.main_vertex = mainShader.vertex ? mainShader.vertex : "default.vert";
+    pipelines_build.main_frag = mainShader.frag ? mainShader.frag : "default.frag";
+    pipelines_build.back_vertex = backShader.vertex ? backShader.vertex : "default.vert";
+    pipelines_build.back_frag = backShader.frag ? backShader.frag : "default.frag";
+
+    VkDescriptorSetLayout descSetLayout = m_frames.desc_set_layout;
+    VkRenderPass renderPass = vulkan_window->defaultRenderPass();
+    VkSampleCountFlagBits samples = vulkan_window->sampleCountFlagBits();
+    pipelines_built = false;
+    pipelines_worker = thread([this, descSetLayout, renderPass, samples]() {
+        PipelinesBuild &build = pipelines_build;
+        shader_setting shader{};
+
+        // An exception can't leave the thread, a failed pipeline stays null so the old one is kept
+        auto buildPipeline = [&](const shader_setting &pipelineShader, VkPipelineLayout &layout, VkPipeline &pipeline) {
+            try {
+                createPipline(pipelineShader, renderPass, samples, descSetLayout, layout, pipeline);
+            }
+            catch (const exception &error) {
+                printf("%s\n", error.what());
+                layout = VK_NULL_HANDLE;
+                pipeline = VK_NULL_HANDLE;
+            }
+        };
+
+        if (build.shaders & 1) {
+            shader.vertex = build.main_vertex.data();
+            shader.frag = build.main_frag.data();
+            buildPipeline(shader, build.main_pipelineLayout, build.main_pipeline);
+        }
+        if (build.shaders & 2) {
+            shader.vertex = build.back_vertex.data();
+            shader.frag = build.back_frag.data();
+            buildPipeline(shader, build.back_pipelineLayout, build.back_pipeline);
+        }
+        if (build.shaders & 4)
+            buildPipeline(get_spectrogram_shader(), build.spectrogram_pipelineLayout, build.spectrogram_pipeline);
+        pipelines_built = true;
+    });
+}
+
+// Swaps in what was built, keeps the old pipeline if the new one failed
+void VulkanRenderer::finishPipelinesBuild() {
+    pipelines_worker.join();
+    PipelinesBuild &build = pipelines_build;
+
+    VkPipelineLayout *layouts[] = {&main_pipelineLayout, &back_pipelineLayout, &spectrogram_pipelineLayout};
+    VkPipeline *pipelines[] = {&main_pipeline, &back_pipeline, &spectrogram_pipeline};
+    VkPipelineLayout builtLayouts[] = {build.main_pipelineLayout, build.back_pipelineLayout,
+                                       build.spectrogram_pipelineLayout};
+    VkPipeline builtPipelines[] = {build.main_pipeline, build.back_pipeline, build.spectrogram_pipeline};
+    const char *names[] = {"main", "back", "spectrogram"};
+
+    for (uint i=0; i < 3; i++) {
+        if (!(build.shaders & (1 << i)))
+            continue;
+
+        if (builtPipelines[i]) {
+            this->retirePipeline(*pipelines[i], *layouts[i]);
+            *pipelines[i] = builtPipelines[i];
+            *layouts[i] = builtLayouts[i];
+
+            if (i == 0)
+                main_animated = is_animated_shader(build.main_vertex, build.main_frag);
+            else if (i == 1)
+                back_animated = is_animated_shader(build.back_vertex, build.back_frag);
+        }
+        else {
+            printf("Keeping the old %s shader\n", names[i]);
+            this->retirePipeline(VK_NULL_HANDLE, builtLayouts[i]);
+        }
     }
-    this->initSwapChainResources();
-}
\ No newline at end of file
+    pipelines_build = PipelinesBuild();
+    pipelines_built = false;
+}
+
+void VulkanRenderer::retirePipeline(VkPipeline pipeline, VkPipelineLayout layout) {
+    // Frames recorded up to now may still be in flight
+    retired_pipelines.push_back({pipeline, layout, frame_count});
+}
+
+void VulkanRenderer::destroyRetiredPipelines(bool all) {
+    // QVulkanWindow waits for a frame slot's previous frame before reusing it
+    const u_int64_t concurrentFrameCount = vulkan_window->concurrentFrameCount();
+
+    for (size_t i=0; i < retired_pipelines.size();) {
+        RetiredPipeline &retired = retired_pipelines[i];
+        if (!all && frame_count < retired.last_frame + concurrentFrameCount) {
+            i++;
+            continue;
+        }
+        if (retired.pipeline)
+            dev_funct->vkDestroyPipeline(vulkan_dev, retired.pipeline, nullptr);
+        if (retired.layout)
+            dev_funct->vkDestroyPipelineLayout(vulkan_dev, retired.layout, nullptr);
+
+        retired_pipelines.erase(retired_pipelines.begin() + i);
+    }
+}
@@ -295,6 +295,10 @@ SettingsTabWidget::SettingsTabWidget() {
         drawModeButton->setText("Bars");
     else if (recidia_settings.design.draw_mode == 1)
         drawModeButton->setText("Points");
+    else if (recidia_settings.design.draw_mode == 2)
+        drawModeButton->setText("Spectrogram");
+    else if (recidia_settings.design.draw_mode == 3)
+        drawModeButton->setText("Curve");
     QObject::connect(drawModeButton, &QPushButton::pressed,
     [=]() {
         if (drawModeButton->text() == "Bars") {
@@ -302,6 +306,14 @@ SettingsTabWidget::SettingsTabWidget() {
             drawModeButton->setText("Points");
         }
         else if (drawModeButton->text() == "Points") {
+            recidia_settings.design.draw_mode = 2;
+            drawModeButton->setText("Spectrogram");
+        }
+        else if (drawModeButton->text() == "Spectrogram") {
+            recidia_settings.design.draw_mode = 3;
+            drawModeButton->setText("Curve");
+        }
+        else if (drawModeButton->text() == "Curve") {
             recidia_settings.design.draw_mode = 0;
             drawModeButton->setText("Bars");
         }
@@ -321,6 +333,58 @@ SettingsTabWidget::SettingsTabWidget() {
     });
     designTabLayout->addWidget(minHeightSpinBox, 3, 3);
 
+    QLabel *layoutLabel = new QLabel("Layout", this);
+    designTabLayout->addWidget(layoutLabel, 0, 5);
+    layoutButton = new QPushButton(this);
+    if (recidia_settings.design.layout == 0)
+        layoutButton->setText("Linear");
+    else if (recidia_settings.design.layout == 1)
+        layoutButton->setText("Mirrored");
+    else if (recidia_settings.design.layout == 2)
+        layoutButton->setText("Radial");
+    QObject::connect(layoutButton, &QPushButton::pressed,
+    [=]() {
+        if (layoutButton->text() == "Linear") {
+            recidia_settings.design.layout = 1;
+            layoutButton->setText("Mirrored");
+        }
+        else if (layoutButton->text() == "Mirrored") {
+            recidia_settings.design.layout = 2;
+            layoutButton->setText("Radial");
+        }
+        else if (layoutButton->text() == "Radial") {
+            recidia_settings.design.layout = 0;
+            layoutButton->setText("Linear");
+        }
+    });
+    designTabLayout->addWidget(layoutButton, 1, 5);
+
+    QLabel *innerRadiusLabel = new QLabel("Inner Radius", this);
+    designTabLayout->addWidget(innerRadiusLabel, 2, 5);
+    QDoubleSpinBox *innerRadiusSpinBox = new QDoubleSpinBox(this);
+    innerRadiusSpinBox->setDecimals(3);
+    innerRadiusSpinBox->setRange(0.0, 1.0);
+    innerRadiusSpinBox->setValue(recidia_settings.design.inner_radius);
+    innerRadiusSpinBox->setSingleStep(0.01);
+    QObject::connect(innerRadiusSpinBox, QOverload<double>::of(&QDoubleSpinBox::valueChanged),
+    [=](double value) {
+        recidia_settings.design.inner_radius = value;
+    });
+    designTabLayout->addWidget(innerRadiusSpinBox, 3, 5);
+
+    QLabel *startAngleLabel = new QLabel("Start Angle", this);
+    designTabLayout->addWidget(startAngleLabel, 0, 6);
+    QDoubleSpinBox *startAngleSpinBox = new QDoubleSpinBox(this);
+    startAngleSpinBox->setDecimals(1);
+    startAngleSpinBox->setRange(-360.0, 360.0);
+    startAngleSpinBox->setValue(recidia_settings.design.start_angle);
+    startAngleSpinBox->setSingleStep(5.0);
+    QObject::connect(startAngleSpinBox, QOverload<double>::of(&QDoubleSpinBox::valueChanged),
+    [=](double value) {
+        recidia_settings.design.start_angle = value;
+    });
+    designTabLayout->addWidget(startAngleSpinBox, 1, 6);
+
     QLabel *mainColorLabel = new QLabel("Main Color", this);
     designTabLayout->addWidget(mainColorLabel, 0, 4);
     QPushButton *mainColorButton = new QPushButton("Modify", this);
@@ -346,6 +410,7 @@ SettingsTabWidget::SettingsTabWidget() {
             recidia_settings.design.main_color.green = new_color.green();
             recidia_settings.design.main_color.blue = new_color.blue();
             recidia_settings.design.main_color.alpha = new_color.alpha();
+            recidia_settings.design.colors_generation++;
         });
         QObject::connect(dialog, &QDialog::accepted,
         [=](){
@@ -358,6 +423,7 @@ SettingsTabWidget::SettingsTabWidget() {
             recidia_settings.design.main_color.green = old_color.green();
             recidia_settings.design.main_color.blue = old_color.blue();
             recidia_settings.design.main_color.alpha = old_color.alpha();
+            recidia_settings.design.colors_generation++;
         });
         QObject::connect(dialog, &QDialog::finished,
         [=](){
@@ -391,6 +457,7 @@ SettingsTabWidget::SettingsTabWidget() {
              recidia_settings.design.back_color.green = new_color.green();
              recidia_settings.design.back_color.blue = new_color.blue();
              recidia_settings.design.back_color.alpha = new_color.alpha();
+             recidia_settings.design.colors_generation++;
          });
          QObject::connect(dialog, &QDialog::accepted,
          [=](){
@@ -403,6 +470,7 @@ SettingsTabWidget::SettingsTabWidget() {
              recidia_settings.design.back_color.green = old_color.green();
              recidia_settings.design.back_color.blue = old_color.blue();
              recidia_settings.design.back_color.alpha = old_color.alpha();
+             recidia_settings.design.colors_generation++;
          });
          QObject::connect(dialog, &QDialog::finished,
          [=](){
@@ -411,18 +479,18 @@ SettingsTabWidget::SettingsTabWidget() {
      });
     designTabLayout->addWidget(backColorButton, 3, 4);
 
-    // QLabel *fpsCapLabel = new QLabel("FPS Cap:", this);
-    // fpsCapLabel->setAlignment(Qt::AlignRight | Qt::AlignVCenter);
-    // designTabLayout->addWidget(fpsCapLabel, 4, 3);
-    // fpsCapSpinBox = new QSpinBox(this);
-    // fpsCapSpinBox->setRange(1, recidia_settings.design.FPS_CAP.MAX);
-    // fpsCapSpinBox->setValue(recidia_settings.design.fps_cap);
-    // fpsCapSpinBox->setSuffix(" FPS");
-    // QObject::connect(fpsCapSpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
-    // [=](int value) {
-    //     recidia_settings.design.fps_cap = value;
-    // });
-    // designTabLayout->addWidget(fpsCapSpinBox, 4, 4);
+    QLabel *fpsCapLabel = new QLabel("FPS Cap:", this);
+    fpsCapLabel->setAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    designTabLayout->addWidget(fpsCapLabel, 4, 3);
+    fpsCapSpinBox = new QSpinBox(this);
+    fpsCapSpinBox->setRange(1, recidia_settings.design.FPS_CAP.MAX);
+    fpsCapSpinBox->setValue(recidia_settings.design.fps_cap);
+    fpsCapSpinBox->setSuffix(" FPS");
+    QObject::connect(fpsCapSpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
+    [=](int value) {
+        recidia_settings.design.fps_cap = value;
+    });
+    designTabLayout->addWidget(fpsCapSpinBox, 4, 4);
 
 
     QWidget *graphicsTab = new QWidget(this);
@@ -496,9 +564,9 @@ SettingsTabWidget::SettingsTabWidget() {
             strcpy(shadersSettings[i]->vertex, item.toStdString().c_str());
             
             if (i == 0)
-                main_window->vulkan_window->shader_setting_change = 1;
+                main_window->vulkan_window->shader_setting_change |= 1;
             else if (i == 1)
-                main_window->vulkan_window->shader_setting_change = 2;
+                main_window->vulkan_window->shader_setting_change |= 2;
         });
         shaderTabLayout->addWidget(vShaderComboBox, 1, 0);
 
@@ -528,9 +596,9 @@ SettingsTabWidget::SettingsTabWidget() {
             strcpy(shadersSettings[i]->frag, item.toStdString().c_str());
             
             if (i == 0)
-                main_window->vulkan_window->shader_setting_change = 1;
+                main_window->vulkan_window->shader_setting_change |= 1;
             else if (i == 1)
-                main_window->vulkan_window->shader_setting_change = 2;
+                main_window->vulkan_window->shader_setting_change |= 2;
         }); 
         shaderTabLayout->addWidget(fShaderComboBox, 1, 1);
 
@@ -683,13 +751,15 @@ void SettingsTabWidget::change_setting(int change) {
             drawModeButton->pressed();
             break;
 
-        // case FPS_CAP_DECREASE:
-        //     fpsCapSpinBox->setValue(fpsCapSpinBox->value() - 1);
-        //     fpsCapSpinBox->editingFinished();
-        //     break;
-        // case FPS_CAP_INCREASE:
-        //     fpsCapSpinBox->setValue(fpsCapSpinBox->value() + 1);
-        //     fpsCapSpinBox->editingFinished();
-        //     break;
+        case LAYOUT_TOGGLE:
+            layoutButton->pressed();
+            break;
+
+        case FPS_CAP_DECREASE:
+            fpsCapSpinBox->setValue(fpsCapSpinBox->value() - 1);
+            break;
+        case FPS_CAP_INCREASE:
+            fpsCapSpinBox->setValue(fpsCapSpinBox->value() + 1);
+            break;
     }
 }
@@ -8,10 +8,12 @@
 #include <recidia.h>
 
 void StatsWidget::updateStats() {
-    plotsCountLabel->setText("Plots: " + QString::number(recidia_data.plots_count));
+    plotsCountLabel->setText("Plots: " + QString::number(recidia_data.drawn_plots_count));
     latencyLabel->setText("Latency: " + QString::number(recidia_data.latency, 'f', 1) + "ms");
     uint fps = (1000 / (recidia_data.frame_time / 1000)) + 0.5;
     fpsLabel->setText("FPS: " + QString::number(fps));
+    gpuTimeLabel->setText("GPU: " + QString::number(recidia_data.gpu_back_time, 'f', 2) + "ms back, "
+                          + QString::number(recidia_data.gpu_main_time, 'f', 2) + "ms main");
 }
 
 void StatsWidget::hideEvent(QHideEvent *event) {
@@ -31,7 +33,7 @@ StatsWidget::StatsWidget() {
     QHBoxLayout *layout = new QHBoxLayout;
     this->setLayout(layout);
 
-    plotsCountLabel = new QLabel("Plots: " + QString::number(recidia_data.plots_count), this);
+    plotsCountLabel = new QLabel("Plots: " + QString::number(recidia_data.drawn_plots_count), this);
     layout->addWidget(plotsCountLabel, 1);
 
     latencyLabel = new QLabel("Latency: " + QString::number(0) + "ms", this);
@@ -40,6 +42,9 @@ StatsWidget::StatsWidget() {
     fpsLabel = new QLabel("FPS: " + QString::number(0), this);
     layout->addWidget(fpsLabel, 1);
 
+    gpuTimeLabel = new QLabel("GPU: " + QString::number(0) + "ms", this);
+    layout->addWidget(gpuTimeLabel, 2);
+
     QLabel *intervalLabel = new QLabel("Interval:", this);
     layout->addWidget(intervalLabel);
     QSpinBox *intervalSpinBox = new QSpinBox(this);